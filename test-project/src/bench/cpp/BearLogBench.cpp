@@ -0,0 +1,293 @@
+// Measures what one BearLog::Log() call costs, for every overload, in desktop simulation.
+//
+//   bearlogBench [--keys <count>,...] [--calls <count>] [--nt on|off] [--async on|off] [--label <name>]
+//                [--report <file.csv>]
+//
+// Prints the time and heap allocations per call as CSV, for the first call to each key and for calls once it is
+// registered. A comparison of Entry with string keys goes to stderr.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <frc/DataLogManager.h>
+#include <frc/geometry/Pose2d.h>
+#include <hal/HAL.h>
+#include <networktables/NetworkTableInstance.h>
+
+#include "bearlog/bearlog.h"
+
+namespace {
+
+// Per thread, so allocations on NetworkTables' and BearLog's own threads aren't counted
+thread_local uint64_t threadAllocations = 0;
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  threadAllocations++;
+  if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+  std::vector<size_t> keyCounts = {1, 100, 5000};
+  // Warm calls measured for each overload and key count
+  uint64_t calls = 200000;
+  std::vector<bool> ntModes = {false, true};
+  bool async = false;
+  std::string label = "bearlog";
+  std::string reportPath;
+};
+
+struct Measurement {
+  std::string configuration;
+  std::string overload;
+  size_t keys = 0;
+  std::string phase;
+  uint64_t calls = 0;
+  double nanosPerCall = 0;
+  double allocationsPerCall = 0;
+};
+
+const std::string kStates[] = {"Idle", "Intaking", "Holding", "Scoring"};
+
+/**
+ * Time logOne(key, iteration) over every key, once for the cold pass and then round after round for the warm one.
+ */
+template<typename LogOne>
+void Measure(std::vector<Measurement>& results, const BenchOptions& options, const std::string& configuration,
+             std::string_view overload, size_t keys, LogOne&& logOne) {
+  auto run = [&](std::string_view phase, uint64_t firstIteration, uint64_t rounds) {
+    uint64_t allocationsBefore = threadAllocations;
+    auto start = Clock::now();
+    for (uint64_t iteration = firstIteration; iteration < firstIteration + rounds; iteration++) {
+      for (size_t key = 0; key < keys; key++) {
+        logOne(key, iteration);
+      }
+    }
+    double nanos = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    uint64_t allocations = threadAllocations - allocationsBefore;
+
+    uint64_t calls = rounds * keys;
+    results.push_back(Measurement{configuration, std::string(overload), keys, std::string(phase), calls,
+                                  nanos / calls, static_cast<double>(allocations) / calls});
+  };
+
+  run("cold", 0, 1);
+  run("warm", 1, std::max<uint64_t>(1, options.calls / keys));
+}
+
+void BenchOverloads(std::vector<Measurement>& results, const BenchOptions& options, bool nt, size_t keys) {
+  std::string configuration = std::string("nt_") + (nt ? "on" : "off");
+  // Fresh keys for every overload, so each cold pass registers them
+  std::string prefix = "Bench/" + configuration + "/" + std::to_string(keys) + "/";
+  auto names = [&](std::string_view overload) {
+    std::vector<std::string> keyNames;
+    for (size_t i = 0; i < keys; i++) {
+      keyNames.push_back(prefix + std::string(overload) + "/" + std::to_string(i));
+    }
+    return keyNames;
+  };
+
+  // Values change every call so change filters never skip them
+  std::vector<std::string> doubleKeys = names("double");
+  Measure(results, options, configuration, "double", keys, [&](size_t key, uint64_t iteration) {
+    BearLog::Log(doubleKeys[key], static_cast<double>(iteration + key));
+  });
+
+  std::vector<std::string> stringKeys = names("string");
+  Measure(results, options, configuration, "string", keys, [&](size_t key, uint64_t iteration) {
+    BearLog::Log(stringKeys[key], kStates[(iteration + key) % std::size(kStates)]);
+  });
+
+  std::vector<std::string> arrayKeys = names("double_array");
+  std::vector<double> array(8);
+  Measure(results, options, configuration, "double_array", keys, [&](size_t key, uint64_t iteration) {
+    array[0] = static_cast<double>(iteration + key);
+    BearLog::Log(arrayKeys[key], std::span<const double>(array));
+  });
+
+  std::vector<std::string> structKeys = names("struct");
+  Measure(results, options, configuration, "struct", keys, [&](size_t key, uint64_t iteration) {
+    BearLog::Log(structKeys[key], frc::Pose2d{units::meter_t{static_cast<double>(iteration + key)}, units::meter_t{0},
+                                                 units::radian_t{0}});
+  });
+
+  std::vector<std::string> lazyKeys = names("lazy");
+  Measure(results, options, configuration, "lazy", keys, [&](size_t key, uint64_t iteration) {
+    BearLog::Log(lazyKeys[key], [&] { return static_cast<double>(iteration + key); });
+  });
+
+  // Entries aren't movable, and constructing them isn't part of the cost being measured
+  std::deque<BearLog::Entry<double>> entries;
+  for (std::string& name : names("entry")) {
+    entries.emplace_back(std::move(name));
+  }
+  Measure(results, options, configuration, "entry", keys, [&](size_t key, uint64_t iteration) {
+    entries[key].Log(static_cast<double>(iteration + key));
+  });
+
+  BearLog::Logger logger = BearLog::Sub(prefix + "logger");
+  std::vector<std::string> loggerKeys;
+  for (size_t i = 0; i < keys; i++) {
+    loggerKeys.push_back(std::to_string(i));
+  }
+  Measure(results, options, configuration, "logger", keys, [&](size_t key, uint64_t iteration) {
+    logger.Log(loggerKeys[key], static_cast<double>(iteration + key));
+  });
+}
+
+void WriteCsv(std::ostream& out, const BenchOptions& options, const std::vector<Measurement>& results, bool header) {
+  if (header) {
+    out << "label,configuration,async,overload,keys,phase,calls,ns_per_call,allocs_per_call\n";
+  }
+  for (const Measurement& result : results) {
+    out << options.label << ',' << result.configuration << ',' << (options.async ? "on" : "off") << ','
+        << result.overload << ',' << result.keys << ',' << result.phase << ',' << result.calls << ','
+        << result.nanosPerCall << ',' << result.allocationsPerCall << '\n';
+  }
+}
+
+const Measurement* FindWarm(const std::vector<Measurement>& results, const Measurement& like,
+                            std::string_view overload) {
+  for (const Measurement& result : results) {
+    if (result.configuration == like.configuration && result.keys == like.keys && result.phase == "warm" &&
+        result.overload == overload) {
+      return &result;
+    }
+  }
+  return nullptr;
+}
+
+// Printed to stderr so stdout stays CSV
+void PrintEntrySpeedup(const std::vector<Measurement>& results) {
+  for (const Measurement& entry : results) {
+    if (entry.overload != "entry" || entry.phase != "warm") {
+      continue;
+    }
+    if (const Measurement* keyed = FindWarm(results, entry, "double")) {
+      std::fprintf(stderr, "%s, %zu keys: Entry %.1fns, string key %.1fns, %.2fx\n", entry.configuration.c_str(),
+                   entry.keys, entry.nanosPerCall, keyed->nanosPerCall, keyed->nanosPerCall / entry.nanosPerCall);
+    }
+  }
+}
+
+bool ParseKeyCounts(std::string_view value, std::vector<size_t>& keyCounts) {
+  keyCounts.clear();
+  while (!value.empty()) {
+    size_t comma = value.find(',');
+    size_t count = std::strtoul(std::string(value.substr(0, comma)).c_str(), nullptr, 10);
+    if (count == 0) {
+      return false;
+    }
+    keyCounts.push_back(count);
+    value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+  }
+  return !keyCounts.empty();
+}
+
+int PrintUsage() {
+  std::fprintf(stderr,
+               "Usage: bearlogBench [options]\n"
+               "\n"
+               "  --keys    Comma separated key counts to run each overload with. Defaults to 1,100,5000.\n"
+               "  --calls   Warm calls measured for each overload and key count. Defaults to 200000.\n"
+               "  --nt      Only run with NetworkTables publishing on or off\n"
+               "  --async   Log asynchronously. Defaults to off.\n"
+               "  --label   Name for this run in the output, like the BearLog version\n"
+               "  --report  Also append the results to a CSV file\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BenchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view argument = argv[i];
+    if (i + 1 >= argc) {
+      return PrintUsage();
+    }
+    std::string_view value = argv[++i];
+    bool valid = true;
+
+    if (argument == "--keys") {
+      valid = ParseKeyCounts(value, options.keyCounts);
+    } else if (argument == "--calls") {
+      options.calls = std::strtoull(value.data(), nullptr, 10);
+      valid = options.calls > 0;
+    } else if (argument == "--nt") {
+      valid = value == "on" || value == "off";
+      options.ntModes = {value == "on"};
+    } else if (argument == "--async") {
+      valid = value == "on" || value == "off";
+      options.async = value == "on";
+    } else if (argument == "--label") {
+      options.label = value;
+    } else if (argument == "--report") {
+      options.reportPath = value;
+    } else {
+      valid = false;
+    }
+
+    if (!valid) {
+      return PrintUsage();
+    }
+  }
+
+  // The simulated HAL, for the FPGA clock BearLog timestamps values with
+  if (!HAL_Initialize(500, 0)) {
+    std::fprintf(stderr, "Could not initialize the HAL\n");
+    return 1;
+  }
+  frc::DataLogManager::Start();
+  nt::NetworkTableInstance::GetDefault().StartServer();
+
+  std::vector<Measurement> results;
+  for (bool nt : options.ntModes) {
+    BearLog::SetOptions(BearLogOptions(nt ? BearLogOptions::NTPublish::Yes : BearLogOptions::NTPublish::No,
+                                       BearLogOptions::LogWithNTPrefix::Yes, BearLogOptions::LogExtras::No,
+                                       options.async ? BearLogOptions::AsyncLogging::Yes
+                                                     : BearLogOptions::AsyncLogging::No));
+    for (size_t keys : options.keyCounts) {
+      BenchOverloads(results, options, nt, keys);
+    }
+  }
+
+  WriteCsv(std::cout, options, results, true);
+  PrintEntrySpeedup(results);
+
+  if (!options.reportPath.empty()) {
+    bool isNew = !std::ifstream(options.reportPath).good();
+    std::ofstream out(options.reportPath, std::ios::app);
+    WriteCsv(out, options, results, isNew);
+    if (!out) {
+      std::fprintf(stderr, "Could not write %s\n", options.reportPath.c_str());
+    }
+  }
+  return 0;
+}
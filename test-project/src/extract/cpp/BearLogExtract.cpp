@@ -0,0 +1,124 @@
+// Pulls BearLog's entries out of .wpilog files into CSV or a binary columnar format.
+//
+//   bearlogExtract [--all] [--prefix <key prefix>]... [--threads <count>] [--csv <file>] [--columnar <file>]
+//                  <log.wpilog>
+//
+// Timing and throughput for each step are printed to stderr, so running it without an output file benchmarks
+// reading and decoding a log on its own.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "bearlog/reader/wpilog_columns.h"
+#include "bearlog/reader/wpilog_reader.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void PrintStep(const char* step, double seconds, size_t bytes) {
+  double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+  std::fprintf(stderr, "%-8s %8.3f s %10.1f MB/s\n", step, seconds, seconds > 0.0 ? megabytes / seconds : 0.0);
+}
+
+int PrintUsage() {
+  std::fprintf(stderr,
+               "Usage: bearlogExtract [--all] [--prefix <key prefix>]... [--threads <count>]\n"
+               "                      [--csv <file>] [--columnar <file>] <log.wpilog>\n"
+               "\n"
+               "  --all        Keep every entry, not just the ones BearLog created\n"
+               "  --prefix     Only keep keys starting with the prefix. Can be given more than once.\n"
+               "  --threads    Threads to decode with. Defaults to one per core.\n"
+               "  --csv        Write key,timestamp,value rows\n"
+               "  --columnar   Write the binary columnar format described in wpilog_columns.h\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  WpilogExtractOptions options;
+  std::string csvPath;
+  std::string columnarPath;
+  std::string logPath;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view argument = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (argument == "--all") {
+      options.bearLogOnly = false;
+    } else if (argument == "--prefix" && hasValue) {
+      options.prefixes.emplace_back(argv[++i]);
+    } else if (argument == "--threads" && hasValue) {
+      options.threadCount = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (argument == "--csv" && hasValue) {
+      csvPath = argv[++i];
+    } else if (argument == "--columnar" && hasValue) {
+      columnarPath = argv[++i];
+    } else if (!argument.starts_with("--") && logPath.empty()) {
+      logPath = argument;
+    } else {
+      return PrintUsage();
+    }
+  }
+
+  if (logPath.empty()) {
+    return PrintUsage();
+  }
+
+  auto start = Clock::now();
+  WpilogReader reader;
+  if (!reader.Open(logPath)) {
+    std::fprintf(stderr, "%s\n", reader.GetError().c_str());
+    return 1;
+  }
+  size_t fileSize = reader.GetData().size();
+
+  WpilogExtractor extractor;
+  if (!extractor.Extract(reader, options)) {
+    std::fprintf(stderr, "%s\n", extractor.GetError().c_str());
+    return 1;
+  }
+  PrintStep("extract", SecondsSince(start), fileSize);
+
+  uint64_t rows = 0;
+  for (const WpilogColumn& column : extractor.GetColumns()) {
+    rows += column.GetRowCount();
+  }
+  std::fprintf(stderr, "%llu records, %zu keys, %llu values\n",
+               static_cast<unsigned long long>(extractor.GetRecordCount()), extractor.GetColumns().size(),
+               static_cast<unsigned long long>(rows));
+
+  if (!csvPath.empty()) {
+    start = Clock::now();
+    std::ofstream out(csvPath, std::ios::binary);
+    WpilogCsvWriter::Write(extractor.GetColumns(), out);
+    if (!out) {
+      std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+      return 1;
+    }
+    PrintStep("csv", SecondsSince(start), static_cast<size_t>(out.tellp()));
+  }
+
+  if (!columnarPath.empty()) {
+    start = Clock::now();
+    std::ofstream out(columnarPath, std::ios::binary);
+    WpilogColumnarWriter::Write(extractor.GetColumns(), out);
+    if (!out) {
+      std::fprintf(stderr, "Could not write %s\n", columnarPath.c_str());
+      return 1;
+    }
+    PrintStep("columnar", SecondsSince(start), static_cast<size_t>(out.tellp()));
+  }
+
+  return 0;
+}
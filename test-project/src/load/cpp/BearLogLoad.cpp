@@ -0,0 +1,496 @@
+// Drives a synthetic load through BearLog in desktop simulation and reports how it affects loop timing.
+//
+//   bearlogLoad [--keys <count>] [--mix <type>:<weight>,...] [--array-size <count>] [--rate <Hz>]
+//               [--threads <count>] [--thread-keys <count>] [--thread-rate <Hz>] [--duration <s>] [--warmup <s>]
+//               [--nt on|off] [--extras on|off] [--async on|off] [--label <name>] [--report <file.csv>]
+//
+// The main loop logs each of its keys once per BearLog::Cycle, like Robot::RobotPeriodic(), and producer threads
+// log their own keys at their own rate. Results are printed to stdout and appended to the report as CSV.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <frc/DataLogManager.h>
+#include <frc/geometry/Pose2d.h>
+#include <hal/HAL.h>
+#include <networktables/NetworkTableInstance.h>
+
+#include "bearlog/bearlog.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class KeyType {Double, Integer, Boolean, String, DoubleArray, Struct};
+
+// Names used by --mix
+constexpr std::string_view kKeyTypeNames[] = {"double", "integer", "boolean", "string", "double[]", "struct"};
+// Folder each type's keys are logged under
+constexpr std::string_view kKeyTypeFolders[] = {"Double", "Integer", "Boolean", "String", "DoubleArray", "Struct"};
+
+struct LoadOptions {
+  size_t keys = 200;
+  // Relative share of keys of each KeyType
+  std::vector<double> mix = {60, 15, 10, 5, 5, 5};
+  size_t arraySize = 8;
+  double rate = 50;
+  size_t threads = 0;
+  size_t threadKeys = 50;
+  double threadRate = 250;
+  double duration = 10;
+  double warmup = 1;
+  std::vector<bool> ntModes = {false, true};
+  std::vector<bool> extrasModes = {false, true};
+  bool async = false;
+  std::string label = "bearlog";
+  std::string reportPath;
+};
+
+double MicrosSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/**
+ * Every sample of one measurement, in microseconds.
+ */
+class Distribution {
+public:
+  struct Summary {
+    size_t count = 0;
+    double mean = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double p999 = 0;
+    double max = 0;
+  };
+
+  void Add(double micros) {
+    m_Samples.push_back(micros);
+  }
+
+  void Merge(const Distribution& other) {
+    m_Samples.insert(m_Samples.end(), other.m_Samples.begin(), other.m_Samples.end());
+  }
+
+  Summary Summarize() {
+    Summary summary;
+    summary.count = m_Samples.size();
+    if (m_Samples.empty()) {
+      return summary;
+    }
+
+    std::sort(m_Samples.begin(), m_Samples.end());
+    double total = 0;
+    for (double sample : m_Samples) {
+      total += sample;
+    }
+    summary.mean = total / m_Samples.size();
+    summary.p50 = Percentile(0.5);
+    summary.p90 = Percentile(0.9);
+    summary.p99 = Percentile(0.99);
+    summary.p999 = Percentile(0.999);
+    summary.max = m_Samples.back();
+    return summary;
+  }
+
+  // One row per power of two microseconds
+  void PrintHistogram() const {
+    static constexpr size_t kBuckets = 18;
+    static constexpr int kBarWidth = 40;
+
+    std::vector<size_t> counts(kBuckets, 0);
+    for (double sample : m_Samples) {
+      size_t bucket = sample < 1 ? 0 : static_cast<size_t>(std::log2(sample)) + 1;
+      counts[std::min(bucket, kBuckets - 1)]++;
+    }
+
+    size_t largest = *std::max_element(counts.begin(), counts.end());
+    for (size_t i = 0; i < kBuckets; i++) {
+      if (counts[i] == 0) {
+        continue;
+      }
+      int width = largest > 0 ? static_cast<int>(counts[i] * kBarWidth / largest) : 0;
+      std::printf("    %8.0f us %8zu %s\n", i == 0 ? 0.0 : std::ldexp(1.0, static_cast<int>(i) - 1), counts[i],
+                  std::string(std::max(width, 1), '#').c_str());
+    }
+  }
+
+private:
+  double Percentile(double fraction) const {
+    auto index = static_cast<size_t>(std::ceil(fraction * m_Samples.size()));
+    return m_Samples[std::clamp<size_t>(index, 1, m_Samples.size()) - 1];
+  }
+
+  std::vector<double> m_Samples;
+};
+
+/**
+ * A set of keys to log, with their names built up front so the harness only measures BearLog.
+ */
+class KeySet {
+public:
+  KeySet(const std::string& prefix, size_t count, const LoadOptions& options) : m_ArraySize(options.arraySize) {
+    double totalWeight = 0;
+    for (double weight : options.mix) {
+      totalWeight += weight;
+    }
+
+    // Hand out keys by weight, so every type gets its share however small the count is
+    std::vector<double> assigned(options.mix.size(), 0);
+    for (size_t i = 0; i < count; i++) {
+      size_t type = 0;
+      double mostBehind = -1;
+      for (size_t t = 0; t < options.mix.size(); t++) {
+        double behind = options.mix[t] / totalWeight * (i + 1) - assigned[t];
+        if (options.mix[t] > 0 && behind > mostBehind) {
+          mostBehind = behind;
+          type = t;
+        }
+      }
+      assigned[type]++;
+
+      auto keyType = static_cast<KeyType>(type);
+      m_Keys.push_back(Key{prefix + std::string(kKeyTypeFolders[type]) + "/" + std::to_string(i), keyType});
+    }
+  }
+
+  void LogAll(uint64_t iteration) {
+    m_Array.resize(m_ArraySize);
+
+    for (size_t i = 0; i < m_Keys.size(); i++) {
+      const Key& key = m_Keys[i];
+      // Values change every iteration so change filters never skip them
+      double value = std::sin(static_cast<double>(iteration + i) * 0.01);
+
+      switch (key.type) {
+        case KeyType::Double:
+          BearLog::Log(key.name, value);
+          break;
+        case KeyType::Integer:
+          BearLog::Log(key.name, static_cast<int>(iteration + i));
+          break;
+        case KeyType::Boolean:
+          BearLog::Log(key.name, (iteration + i) % 2 == 0);
+          break;
+        case KeyType::String:
+          BearLog::Log(key.name, kStates[(iteration + i) % std::size(kStates)]);
+          break;
+        case KeyType::DoubleArray:
+          for (size_t j = 0; j < m_Array.size(); j++) {
+            m_Array[j] = value + j;
+          }
+          BearLog::Log(key.name, std::span<const double>(m_Array));
+          break;
+        case KeyType::Struct:
+          BearLog::Log(key.name, frc::Pose2d{units::meter_t{value}, units::meter_t{-value}, units::radian_t{value}});
+          break;
+      }
+    }
+  }
+
+private:
+  static inline const std::string kStates[] = {"Idle", "Intaking", "Holding", "Scoring"};
+
+  struct Key {
+    std::string name;
+    KeyType type;
+  };
+
+  std::vector<Key> m_Keys;
+  size_t m_ArraySize;
+  std::vector<double> m_Array;
+};
+
+struct RunResult {
+  std::string configuration;
+  double firstCycleMicros = 0;
+  Distribution loopPeriod;
+  Distribution loopLogTime;
+  Distribution threadLogTime;
+};
+
+RunResult Run(const LoadOptions& options, bool nt, bool extras) {
+  RunResult result;
+  result.configuration = std::string("nt_") + (nt ? "on" : "off") + "_extras_" + (extras ? "on" : "off");
+
+  BearLog::SetOptions(BearLogOptions(nt ? BearLogOptions::NTPublish::Yes : BearLogOptions::NTPublish::No,
+                                     BearLogOptions::LogWithNTPrefix::Yes,
+                                     extras ? BearLogOptions::LogExtras::Yes : BearLogOptions::LogExtras::No,
+                                     options.async ? BearLogOptions::AsyncLogging::Yes
+                                                   : BearLogOptions::AsyncLogging::No));
+
+  // Fresh keys for each configuration, so each one pays for registering them
+  std::string prefix = "Load/" + result.configuration + "/";
+  KeySet loopKeys(prefix + "Loop/", options.keys, options);
+
+  std::atomic<bool> running{true};
+  std::atomic<bool> measuring{false};
+  std::vector<Distribution> threadTimes(options.threads);
+  std::vector<std::thread> threads;
+
+  for (size_t t = 0; t < options.threads; t++) {
+    threads.emplace_back([&, t] {
+      KeySet keys(prefix + "Thread" + std::to_string(t) + "/", options.threadKeys, options);
+      auto period =
+          std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.threadRate));
+      auto next = Clock::now();
+
+      for (uint64_t iteration = 0; running.load(std::memory_order_relaxed); iteration++) {
+        auto start = Clock::now();
+        keys.LogAll(iteration);
+        if (measuring.load(std::memory_order_relaxed)) {
+          threadTimes[t].Add(MicrosSince(start));
+        }
+
+        next += period;
+        std::this_thread::sleep_until(next);
+      }
+    });
+  }
+
+  auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.rate));
+  auto runStart = Clock::now();
+  auto measureStart = runStart + std::chrono::duration_cast<Clock::duration>(
+                                     std::chrono::duration<double>(options.warmup));
+  auto runEnd = measureStart + std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double>(options.duration));
+  auto next = runStart;
+  auto lastWake = runStart;
+
+  for (uint64_t iteration = 0;; iteration++) {
+    auto wake = Clock::now();
+    if (wake >= runEnd) {
+      break;
+    }
+    bool measure = wake >= measureStart;
+    measuring.store(measure, std::memory_order_relaxed);
+
+    {
+      auto start = Clock::now();
+      {
+        BearLog::Cycle cycle;
+        loopKeys.LogAll(iteration);
+      }
+      double logMicros = MicrosSince(start);
+
+      if (iteration == 0) {
+        result.firstCycleMicros = logMicros;
+      }
+      if (measure) {
+        result.loopLogTime.Add(logMicros);
+        if (iteration > 0) {
+          result.loopPeriod.Add(std::chrono::duration<double, std::micro>(wake - lastWake).count());
+        }
+      }
+    }
+    lastWake = wake;
+
+    // Like TimedRobot, a late loop runs the next one straight away rather than skipping it
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+
+  running.store(false);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (const Distribution& times : threadTimes) {
+    result.threadLogTime.Merge(times);
+  }
+  return result;
+}
+
+void PrintMetric(std::string_view name, Distribution& distribution) {
+  Distribution::Summary summary = distribution.Summarize();
+  if (summary.count == 0) {
+    return;
+  }
+  std::printf("  %s: n=%zu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f us\n", std::string(name).c_str(),
+              summary.count, summary.mean, summary.p50, summary.p90, summary.p99, summary.p999, summary.max);
+  distribution.PrintHistogram();
+}
+
+void WriteReport(const LoadOptions& options, std::vector<RunResult>& results) {
+  bool isNew = !std::ifstream(options.reportPath).good();
+  std::ofstream out(options.reportPath, std::ios::app);
+  if (isNew) {
+    out << "label,configuration,async,keys,threads,thread_keys,rate_hz,metric,count,mean_us,p50_us,p90_us,p99_us,"
+           "p999_us,max_us\n";
+  }
+
+  for (RunResult& result : results) {
+    std::pair<std::string_view, Distribution*> metrics[] = {
+        {"loop_period", &result.loopPeriod}, {"loop_log_time", &result.loopLogTime},
+        {"thread_log_time", &result.threadLogTime}};
+
+    for (auto& [metric, distribution] : metrics) {
+      Distribution::Summary summary = distribution->Summarize();
+      if (summary.count == 0) {
+        continue;
+      }
+      out << options.label << ',' << result.configuration << ',' << (options.async ? "on" : "off") << ','
+          << options.keys << ',' << options.threads << ',' << options.threadKeys << ',' << options.rate << ','
+          << metric << ',' << summary.count << ',' << summary.mean << ',' << summary.p50 << ',' << summary.p90
+          << ',' << summary.p99 << ',' << summary.p999 << ',' << summary.max << '\n';
+    }
+    out << options.label << ',' << result.configuration << ',' << (options.async ? "on" : "off") << ','
+        << options.keys << ',' << options.threads << ',' << options.threadKeys << ',' << options.rate
+        << ",first_cycle,1," << result.firstCycleMicros << ",,,,,\n";
+  }
+
+  if (!out) {
+    std::fprintf(stderr, "Could not write %s\n", options.reportPath.c_str());
+  }
+}
+
+bool ParseOnOff(std::string_view value, std::vector<bool>& modes) {
+  if (value == "on" || value == "off") {
+    modes = {value == "on"};
+    return true;
+  }
+  return false;
+}
+
+// "double:60,string:5" sets the weight of each listed type and leaves out the rest
+bool ParseMix(std::string_view value, std::vector<double>& mix) {
+  mix.assign(std::size(kKeyTypeNames), 0);
+
+  while (!value.empty()) {
+    size_t comma = value.find(',');
+    std::string_view item = value.substr(0, comma);
+    value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+    size_t colon = item.find(':');
+    if (colon == std::string_view::npos) {
+      return false;
+    }
+    auto type = std::find(std::begin(kKeyTypeNames), std::end(kKeyTypeNames), item.substr(0, colon));
+    if (type == std::end(kKeyTypeNames)) {
+      return false;
+    }
+    mix[type - std::begin(kKeyTypeNames)] = std::strtod(std::string(item.substr(colon + 1)).c_str(), nullptr);
+  }
+
+  return std::any_of(mix.begin(), mix.end(), [](double weight) { return weight > 0; });
+}
+
+int PrintUsage() {
+  std::fprintf(stderr,
+               "Usage: bearlogLoad [options]\n"
+               "\n"
+               "  --keys         Keys logged by the main loop each cycle. Defaults to 200.\n"
+               "  --mix          Share of each type. Defaults to\n"
+               "                 double:60,integer:15,boolean:10,string:5,double[]:5,struct:5\n"
+               "  --array-size   Elements in each double[] value. Defaults to 8.\n"
+               "  --rate         Main loop rate in Hz. Defaults to 50.\n"
+               "  --threads      Producer threads logging besides the main loop. Defaults to 0.\n"
+               "  --thread-keys  Keys logged by each producer thread. Defaults to 50.\n"
+               "  --thread-rate  Producer thread rate in Hz. Defaults to 250.\n"
+               "  --duration     Seconds measured for each configuration. Defaults to 10.\n"
+               "  --warmup       Seconds run before measuring. Defaults to 1.\n"
+               "  --nt           Only run with NetworkTables publishing on or off\n"
+               "  --extras       Only run with extras on or off\n"
+               "  --async        Log asynchronously. Defaults to off.\n"
+               "  --label        Name for this run in the report, like the BearLog version\n"
+               "  --report       Append the results to a CSV file\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  LoadOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view argument = argv[i];
+    if (i + 1 >= argc) {
+      return PrintUsage();
+    }
+    std::string_view value = argv[++i];
+    bool valid = true;
+
+    if (argument == "--keys") {
+      options.keys = std::strtoul(value.data(), nullptr, 10);
+    } else if (argument == "--mix") {
+      valid = ParseMix(value, options.mix);
+    } else if (argument == "--array-size") {
+      options.arraySize = std::strtoul(value.data(), nullptr, 10);
+    } else if (argument == "--rate") {
+      options.rate = std::strtod(value.data(), nullptr);
+      valid = options.rate > 0;
+    } else if (argument == "--threads") {
+      options.threads = std::strtoul(value.data(), nullptr, 10);
+    } else if (argument == "--thread-keys") {
+      options.threadKeys = std::strtoul(value.data(), nullptr, 10);
+    } else if (argument == "--thread-rate") {
+      options.threadRate = std::strtod(value.data(), nullptr);
+      valid = options.threadRate > 0;
+    } else if (argument == "--duration") {
+      options.duration = std::strtod(value.data(), nullptr);
+    } else if (argument == "--warmup") {
+      options.warmup = std::strtod(value.data(), nullptr);
+    } else if (argument == "--nt") {
+      valid = ParseOnOff(value, options.ntModes);
+    } else if (argument == "--extras") {
+      valid = ParseOnOff(value, options.extrasModes);
+    } else if (argument == "--async") {
+      valid = value == "on" || value == "off";
+      options.async = value == "on";
+    } else if (argument == "--label") {
+      options.label = value;
+    } else if (argument == "--report") {
+      options.reportPath = value;
+    } else {
+      valid = false;
+    }
+
+    if (!valid) {
+      return PrintUsage();
+    }
+  }
+
+  // The simulated HAL, for the FPGA clock BearLog timestamps values with
+  if (!HAL_Initialize(500, 0)) {
+    std::fprintf(stderr, "Could not initialize the HAL\n");
+    return 1;
+  }
+  frc::DataLogManager::Start();
+  nt::NetworkTableInstance::GetDefault().StartServer();
+
+  std::printf("%s: %zu keys at %.0f Hz, %zu threads x %zu keys at %.0f Hz, async %s\n", options.label.c_str(),
+              options.keys, options.rate, options.threads, options.threadKeys, options.threadRate,
+              options.async ? "on" : "off");
+
+  std::vector<RunResult> results;
+  for (bool nt : options.ntModes) {
+    for (bool extras : options.extrasModes) {
+      RunResult& result = results.emplace_back(Run(options, nt, extras));
+
+      std::printf("\n%s\n  first cycle, registering every key: %.1f us\n", result.configuration.c_str(),
+                  result.firstCycleMicros);
+      PrintMetric("loop period", result.loopPeriod);
+      PrintMetric("loop log time", result.loopLogTime);
+      PrintMetric("thread log time", result.threadLogTime);
+    }
+  }
+
+  std::printf("\nDropped %llu async records, suppressed %llu unchanged values\n",
+              static_cast<unsigned long long>(BearLog::GetDroppedRecordCount()),
+              static_cast<unsigned long long>(BearLog::GetSuppressedWriteCount()));
+
+  if (!options.reportPath.empty()) {
+    WriteReport(options, results);
+  }
+  return 0;
+}
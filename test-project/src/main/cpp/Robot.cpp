@@ -14,12 +14,23 @@ Robot::Robot() {
   BearLog::SetOptions(BearLogOptions(BearLogOptions::NTPublish::Yes,
                                      BearLogOptions::LogWithNTPrefix::Yes,
                                      BearLogOptions::LogExtras::Yes));
+  // Turn groups of keys on and off from src/main/deploy/bearlog_filter.txt or the /BearLog/KeyFilter topic
+  BearLog::LoadKeyFilterFile();
+  BearLog::ListenForKeyFilter();
+  // Register every key the last run logged, so they aren't created for the first time mid-match
+  BearLog::LoadKeyManifest();
+
   std::srand(std::time(nullptr));
 
   BearLog::SetPdh(std::make_shared<frc::PowerDistribution>());
 }
 
 void Robot::RobotPeriodic() {
+  // Every value logged during this loop shares one timestamp
+  BearLog::Cycle cycle;
+  // Time the rest of RobotPeriodic(). Declared after the cycle so it is logged when the cycle ends.
+  BEARLOG_PROFILE_SCOPE();
+
   frc2::CommandScheduler::GetInstance().Run();
 
   // Basic position value
@@ -53,7 +64,9 @@ void Robot::RobotPeriodic() {
   BearLog::Log("Units/Velocity", 42_mps);
 }
 
-void Robot::DisabledInit() {}
+void Robot::DisabledInit() {
+  BearLog::SaveKeyManifest();
+}
 
 void Robot::DisabledPeriodic() {}
 
@@ -1,19 +1,67 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <deque>
+#include <fstream>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
+#include <frc/DataLogManager.h>
+#include <frc/Errors.h>
+#include <frc/Filesystem.h>
 #include <frc/Notifier.h>
 #include <frc/PowerDistribution.h>
 #include <frc/RobotController.h>
 
+#include "bearlog/internal/async_log_writer.h"
+#include "bearlog/internal/concurrent_key_registry.h"
 #include "bearlog/internal/data_log_writer.h"
+#include "bearlog/internal/extras_sources.h"
+#include "bearlog/internal/key_filter.h"
+#include "bearlog/internal/log_sink.h"
+#include "bearlog/internal/log_slot.h"
+#include "bearlog/internal/log_stats.h"
+#include "bearlog/internal/network_tables_batch.h"
 #include "bearlog/internal/network_tables_writer.h"
+#include "bearlog/internal/profiler.h"
+#include "bearlog/internal/unit_suffix.h"
 
 class BearLogOptions {
 public:
   enum class NTPublish {No, Yes};
   enum class LogWithNTPrefix {No, Yes};
   enum class LogExtras {No, Yes};
+  enum class AsyncLogging {No, Yes};
+
+  using OverflowPolicy = RingOverflowPolicy;
+
+  static constexpr size_t kDefaultAsyncQueueCapacity = 4096;
+
+  using ChangeFilter = ::ChangeFilter;
+  using Decimation = ::Decimation;
+
+  enum class Sink {DataLog, NetworkTables};
+
+  // When NetworkTables sends values. Periodic leaves it to NetworkTables' own timer. EveryCycle holds back each
+  // cycle's values until EndCycle(), sets them all at once and flushes them.
+  enum class NTFlush {Periodic, EveryCycle};
+
+  // Where the log file is written. SinksOnly leaves it to the sinks added with BearLog::AddSink(), like a
+  // MappedFileSink, and skips DataLogManager.
+  enum class FileOutput {DataLog, SinksOnly};
+
+  // Sources of extras logged when LogExtras is on, each sampled on its own thread at its own rate
+  enum class Extras {PowerDistribution, RobotController, Process, BearLog};
 
   /**
    * Use enum classes as parameters instead of bools:
@@ -23,83 +71,394 @@ public:
    */
   BearLogOptions(NTPublish ntPublish = NTPublish::Yes,
                  LogWithNTPrefix withNTPrefix = LogWithNTPrefix::Yes,
-                 LogExtras logExtras = LogExtras::No)
+                 LogExtras logExtras = LogExtras::No,
+                 AsyncLogging asyncLogging = AsyncLogging::No)
       : m_NtPublish(ntPublish),
         m_LogWithNTPrefix(withNTPrefix),
-        m_LogExtras(logExtras) {}
+        m_LogExtras(logExtras),
+        m_AsyncLogging(asyncLogging) {}
+
+  /**
+   * Configure the queue used when AsyncLogging is enabled. The capacity is the number of values that can be
+   * waiting to be written and is rounded up to a power of two.
+   */
+  BearLogOptions& SetAsyncQueue(size_t capacity, OverflowPolicy policy) {
+    m_AsyncQueueCapacity = capacity;
+    m_OverflowPolicy = policy;
+    return *this;
+  }
 
-  bool ShouldPublishToNetworkTables() {
+  bool ShouldPublishToNetworkTables() const {
     return m_NtPublish == NTPublish::Yes;
   }
 
-  bool ShouldLogToFileWithNTPrefix() {
+  bool ShouldLogToFileWithNTPrefix() const {
     return m_LogWithNTPrefix == LogWithNTPrefix::Yes;
   }
 
-  bool ShouldLogExtras() {
+  /**
+   * Skip writing values that haven't changed, for every key that doesn't have its own filter set with
+   * BearLog::SetChangeFilter(). Only applies to keys logged for the first time after the options are set.
+   */
+  BearLogOptions& SetChangeFilter(ChangeFilter filter) {
+    m_ChangeFilter = filter;
+    return *this;
+  }
+
+  /**
+   * Cap how often values for keys starting with the prefix are written to one sink. For example, to keep the
+   * log file at full rate but only publish debug values to NetworkTables at 10Hz:
+   *
+   *   options.AddRateLimit(BearLogOptions::Sink::NetworkTables, "Debug/", 10_Hz);
+   *
+   * When more than one prefix matches a key, the longest one wins. A rate of 0Hz or less keeps those keys out of
+   * the sink entirely. Only applies to keys logged for the first time after the options are set.
+   */
+  BearLogOptions& AddRateLimit(Sink sink, std::string prefix, units::hertz_t rate,
+                               Decimation decimation = Decimation::Latest) {
+    std::vector<RateLimit>& rateLimits = sink == Sink::DataLog ? m_DataLogRateLimits : m_NTRateLimits;
+    rateLimits.push_back(RateLimit{std::move(prefix), rate, decimation});
+    return *this;
+  }
+
+  /**
+   * Hold the last few seconds of values for keys starting with the prefix in memory, and only write them to the
+   * log file when BearLog::Trigger() is called, or on a brownout when LogExtras is on. The values keep their
+   * original timestamps. Each key holds up to duration * rate values, allocated once when the key is registered:
+   *
+   *   options.AddFlightRecorder("Drive/Current", 5_s, 250_Hz);
+   *
+   * Only booleans, doubles and integers are held back. NetworkTables publishing isn't affected. Only applies to
+   * keys logged for the first time after the options are set.
+   */
+  BearLogOptions& AddFlightRecorder(std::string prefix, units::second_t duration, units::hertz_t rate) {
+    m_FlightRecorders.push_back(FlightRecorder{std::move(prefix), duration, rate});
+    return *this;
+  }
+
+  /**
+   * Use these NetworkTables publisher options for keys starting with the prefix, for example to send every value
+   * of a fast key rather than only the newest one each period:
+   *
+   *   options.SetPublishOptions("Drive/", {.periodic = 0.02, .sendAll = true, .keepDuplicates = true});
+   *
+   * When more than one prefix matches a key, the longest one wins. Only applies to keys published for the first
+   * time after the options are set.
+   */
+  BearLogOptions& SetPublishOptions(std::string prefix, const nt::PubSubOptions& options) {
+    m_PublishOptions.push_back(PublishOptions{std::move(prefix), options});
+    return *this;
+  }
+
+  /**
+   * Batch each cycle's NetworkTables values and flush them together at the end of the cycle. Values logged outside
+   * of a cycle, or by the async writer thread, are set right away as usual.
+   */
+  BearLogOptions& SetNetworkTablesFlush(NTFlush flush) {
+    m_NTFlush = flush;
+    return *this;
+  }
+
+  /**
+   * Stop writing values to DataLogManager when a sink added with BearLog::AddSink() writes the log file instead.
+   * Only applies to keys logged for the first time after the options are set.
+   */
+  BearLogOptions& SetFileOutput(FileOutput output) {
+    m_FileOutput = output;
+    return *this;
+  }
+
+  bool ShouldLogToDataLog() const {
+    return m_FileOutput == FileOutput::DataLog;
+  }
+
+  bool ShouldLogExtras() const {
     return m_LogExtras == LogExtras::Yes;
   }
 
+  bool ShouldLogAsync() const {
+    return m_AsyncLogging == AsyncLogging::Yes;
+  }
+
+  size_t GetAsyncQueueCapacity() const {
+    return m_AsyncQueueCapacity;
+  }
+
+  OverflowPolicy GetOverflowPolicy() const {
+    return m_OverflowPolicy;
+  }
+
+  const ChangeFilter& GetChangeFilter() const {
+    return m_ChangeFilter;
+  }
+
+  const std::vector<RateLimit>& GetRateLimits(Sink sink) const {
+    return sink == Sink::DataLog ? m_DataLogRateLimits : m_NTRateLimits;
+  }
+
+  const std::vector<FlightRecorder>& GetFlightRecorders() const {
+    return m_FlightRecorders;
+  }
+
+  const std::vector<PublishOptions>& GetPublishOptions() const {
+    return m_PublishOptions;
+  }
+
+  NTFlush GetNetworkTablesFlush() const {
+    return m_NTFlush;
+  }
+
+  /**
+   * Change how often one source of extras is sampled. By default the power distribution module and BearLog's own
+   * stats are sampled at 50Hz, the roboRIO's battery and CAN bus state at 10Hz and the process CPU and memory use
+   * at 1Hz. A rate of 0 turns the source off.
+   */
+  BearLogOptions& SetExtrasRate(Extras source, units::hertz_t rate) {
+    m_ExtrasRates[static_cast<size_t>(source)] = rate;
+    return *this;
+  }
+
+  units::hertz_t GetExtrasRate(Extras source) const {
+    return m_ExtrasRates[static_cast<size_t>(source)];
+  }
+
 private:
   NTPublish m_NtPublish;
   LogWithNTPrefix m_LogWithNTPrefix;
   LogExtras m_LogExtras;
+  AsyncLogging m_AsyncLogging;
+  size_t m_AsyncQueueCapacity = kDefaultAsyncQueueCapacity;
+  OverflowPolicy m_OverflowPolicy = OverflowPolicy::DropOldest;
+  ChangeFilter m_ChangeFilter;
+  std::vector<RateLimit> m_DataLogRateLimits;
+  std::vector<RateLimit> m_NTRateLimits;
+  std::vector<FlightRecorder> m_FlightRecorders;
+  std::vector<PublishOptions> m_PublishOptions;
+  NTFlush m_NTFlush = NTFlush::Periodic;
+  FileOutput m_FileOutput = FileOutput::DataLog;
+  std::array<units::hertz_t, 4> m_ExtrasRates = {units::hertz_t{50}, units::hertz_t{10}, units::hertz_t{1},
+                                                 units::hertz_t{50}};
 };
 
 class BearLog {
   const std::string kLogTable = "/Robot";
+  static constexpr std::string_view kKeyFilterFileName = "bearlog_filter.txt";
+  static constexpr std::string_view kKeyFilterTopic = "/BearLog/KeyFilter";
+  static constexpr std::string_view kTriggerKey = "BearLog/Trigger";
+  static constexpr std::string_view kKeyManifestFileName = "bearlog_manifest.txt";
 
 public:
   // Delete the copy constructor. BearLog should not be cloneable.
   BearLog(const BearLog&) = delete;
 
   ~BearLog() {
-    m_InternalLogNotifier.Stop();
+    StopLoggingExtras();
+
+    if (m_KeyFilterListener != 0) {
+      nt::RemoveListener(m_KeyFilterListener);
+    }
+
+    // Stop the async writer before the writers it feeds are destroyed. Anything still queued is written first.
+    ReplaceAsyncWriter(nullptr);
   }
 
   // Preventing assigning a BearLog object
   BearLog& operator=(const BearLog&) = delete;
 
+  /**
+   * Replace the options. Threads that are logging at the same time keep using the old options until their current
+   * call returns. Meant to be called a handful of times, since every set of options is kept until shutdown.
+   */
   static void SetOptions(BearLogOptions options) {
-    GetInstance().m_Options = options;
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_OptionsMutex);
 
-    GetInstance().m_DataLogger.SetShouldUseNTTablePrefix(options.ShouldLogToFileWithNTPrefix());
+    // Stop everything that runs on its own thread first. The async writer writes out what it still had queued.
+    StopLoggingExtras();
+    ReplaceAsyncWriter(nullptr);
+
+    const BearLogOptions& snapshot = instance.m_OptionSnapshots.emplace_back(std::move(options));
+    instance.m_Options.store(&snapshot, std::memory_order_release);
+
+    instance.m_DataLogger.SetShouldUseNTTablePrefix(snapshot.ShouldLogToFileWithNTPrefix());
+    instance.m_Stats.SetEnabled(snapshot.ShouldLogExtras());
+
+    if (snapshot.ShouldLogAsync()) {
+      ReplaceAsyncWriter(std::make_unique<AsyncLogWriter>(snapshot.GetAsyncQueueCapacity(),
+                                                          snapshot.GetOverflowPolicy(), &BearLog::WriteRecord));
+    }
 
     StartLoggingExtrasIfNeeded();
   }
 
   static void StartLoggingExtrasIfNeeded() {
-    if (GetInstance().m_Options.ShouldLogExtras()) {
-      // Enable the logging loop to log the PDH information (and other extras) at 50Hz
-      static const units::second_t kLoopPeriodSeconds = 0.02_s;
-      GetInstance().m_InternalLogNotifier.StartPeriodic(kLoopPeriodSeconds);
+    BearLog& instance = GetInstance();
+    const BearLogOptions& options = GetOptions();
+    if (!options.ShouldLogExtras()) {
+      return;
     }
+
+    using Extras = BearLogOptions::Extras;
+    instance.m_PdhSampler.Start(options.GetExtrasRate(Extras::PowerDistribution));
+    instance.m_RobotControllerSampler.Start(options.GetExtrasRate(Extras::RobotController));
+    instance.m_ProcessSampler.Start(options.GetExtrasRate(Extras::Process));
+    instance.m_SelfStatsSampler.Start(options.GetExtrasRate(Extras::BearLog));
   }
 
-  void LogExtras() {
-    if (IsEnabled()) {
-      LogPdh();
+  static void StopLoggingExtras() {
+    BearLog& instance = GetInstance();
+    instance.m_PdhSampler.Stop();
+    instance.m_RobotControllerSampler.Stop();
+    instance.m_ProcessSampler.Stop();
+    instance.m_SelfStatsSampler.Stop();
+  }
+
+  /**
+   * Log BearLog's own overhead during the last cycle, or since the last sample when no cycles are running. Logging
+   * these adds a few calls to the next sample's counts.
+   */
+  void LogSelfStats() {
+    if (!IsEnabled()) {
+      return;
+    }
+
+    static const std::string kStatsPrefix = "SystemStats/BearLog/";
+    static Entry<int64_t> callsEntry{kStatsPrefix + "CallsPerCycle"};
+    static Entry<double> logTimeEntry{kStatsPrefix + "LogTimePerCycle(us)"};
+    static Entry<double> logTimeP50Entry{kStatsPrefix + "LogTimeP50(us)"};
+    static Entry<double> logTimeP99Entry{kStatsPrefix + "LogTimeP99(us)"};
+    static Entry<double> logTimeMaxEntry{kStatsPrefix + "LogTimeMax(us)"};
+    static Entry<int64_t> bytesEntry{kStatsPrefix + "BytesPerCycle"};
+    static Entry<int64_t> newKeysEntry{kStatsPrefix + "NewKeysPerCycle"};
+    static Entry<int64_t> ntPublishersEntry{kStatsPrefix + "NTPublishers"};
+    static Entry<int64_t> suppressedWritesEntry{kStatsPrefix + "SuppressedWrites"};
+    static Entry<int64_t> droppedRecordsEntry{kStatsPrefix + "DroppedRecords"};
+    static const std::vector<std::unique_ptr<Entry<int64_t>>> typeEntries = [] {
+      std::vector<std::unique_ptr<Entry<int64_t>>> entries;
+      for (std::string_view typeName : LogStats::kTypeNames) {
+        entries.push_back(std::make_unique<Entry<int64_t>>(kStatsPrefix + "Entries/" + std::string(typeName)));
+      }
+      return entries;
+    }();
+
+    // Once cycles are running, publish the counts latched at the end of the last one. A cycle that ends between
+    // two samples is skipped rather than merged, so each sample covers exactly one cycle.
+    BearLog& instance = GetInstance();
+    LogStats::Snapshot stats;
+    if (instance.m_Stats.LatchesCycles()) {
+      std::optional<LogStats::Snapshot> latched = instance.m_Stats.TakeLatched();
+      if (!latched) {
+        return;
+      }
+      stats = *latched;
+    } else {
+      stats = instance.m_Stats.Collect();
+    }
+
+    callsEntry.Log(stats.calls);
+    logTimeEntry.Log(stats.totalNanos / 1000.0);
+    logTimeP50Entry.Log(stats.p50Nanos / 1000.0);
+    logTimeP99Entry.Log(stats.p99Nanos / 1000.0);
+    logTimeMaxEntry.Log(stats.maxNanos / 1000.0);
+    bytesEntry.Log(stats.bytesAppended);
+    newKeysEntry.Log(stats.newKeys);
+    for (size_t i = 0; i < LogStats::kTypeCount; i++) {
+      typeEntries[i]->Log(stats.entriesByType[i]);
     }
+    ntPublishersEntry.Log(stats.ntPublishers);
+    suppressedWritesEntry.Log(GetSuppressedWriteCount());
+    droppedRecordsEntry.Log(GetDroppedRecordCount());
   }
 
   void LogPdh() {
-    // Use std::lock_guard to lock access to m_Pdh for the scope of this function. This prevents other functions
-    // from modifying it.
-    const std::lock_guard<std::mutex> lock(GetInstance().m_PdhMutex);
-
-    if (!GetInstance().m_Pdh) {
+    if (!IsEnabled()) {
       return;
     }
 
+    BearLog& instance = GetInstance();
+    {
+      // Use std::lock_guard to lock access to m_Pdh while it is being read. This prevents other functions from
+      // modifying it. The values are logged after the lock is released.
+      const std::lock_guard<std::mutex> lock(instance.m_PdhMutex);
+
+      if (!instance.m_Pdh) {
+        return;
+      }
+
+      instance.m_PdhSnapshot.Read(*instance.m_Pdh);
+    }
+
     static const std::string kPdhPrefix = "SystemStats/PowerDistribution/";
+    static Entry<double> temperatureEntry{kPdhPrefix + "Temperature(C)"};
+    static Entry<double> voltageEntry{kPdhPrefix + "Voltage(V)"};
+    static Entry<std::vector<double>> channelCurrentEntry{kPdhPrefix + "ChannelCurrent(A)"};
+    static Entry<double> totalCurrentEntry{kPdhPrefix + "TotalCurrent(A)"};
+    static Entry<double> totalPowerEntry{kPdhPrefix + "TotalPower(W)"};
+    static Entry<double> totalEnergyEntry{kPdhPrefix + "TotalEnergy(J)"};
+    static Entry<int64_t> channelCountEntry{kPdhPrefix + "ChannelCount"};
+
+    const PdhSnapshot& pdh = instance.m_PdhSnapshot;
+    temperatureEntry.Log(pdh.temperature);
+    voltageEntry.Log(pdh.voltage);
+    channelCurrentEntry.Log(pdh.channelCurrents);
+    totalCurrentEntry.Log(pdh.totalCurrent);
+    totalPowerEntry.Log(pdh.totalPower);
+    totalEnergyEntry.Log(pdh.totalEnergy);
+    channelCountEntry.Log(pdh.channelCount);
+  }
+
+  void LogRobotController() {
+    if (!IsEnabled()) {
+      return;
+    }
+
+    BearLog& instance = GetInstance();
+    RobotControllerSnapshot& robotController = instance.m_RobotControllerSnapshot;
+    robotController.Read();
+
+    static const std::string kRobotControllerPrefix = "SystemStats/RobotController/";
+    static Entry<double> batteryVoltageEntry{kRobotControllerPrefix + "BatteryVoltage(V)"};
+    static Entry<bool> brownedOutEntry{kRobotControllerPrefix + "BrownedOut"};
+    static Entry<double> canUtilizationEntry{kRobotControllerPrefix + "CAN/Utilization"};
+    static Entry<int64_t> canBusOffEntry{kRobotControllerPrefix + "CAN/BusOffCount"};
+    static Entry<int64_t> canTxFullEntry{kRobotControllerPrefix + "CAN/TxFullCount"};
+    static Entry<int64_t> canReceiveErrorEntry{kRobotControllerPrefix + "CAN/ReceiveErrorCount"};
+    static Entry<int64_t> canTransmitErrorEntry{kRobotControllerPrefix + "CAN/TransmitErrorCount"};
+
+    batteryVoltageEntry.Log(robotController.batteryVoltage);
+    brownedOutEntry.Log(robotController.brownedOut);
+    canUtilizationEntry.Log(robotController.canStatus.percentBusUtilization);
+    canBusOffEntry.Log(robotController.canStatus.busOffCount);
+    canTxFullEntry.Log(robotController.canStatus.txFullCount);
+    canReceiveErrorEntry.Log(robotController.canStatus.receiveErrorCount);
+    canTransmitErrorEntry.Log(robotController.canStatus.transmitErrorCount);
+
+    // A brownout dumps the flight recorders, once when it starts
+    if (robotController.brownedOut && !instance.m_WasBrownedOut && !GetOptions().GetFlightRecorders().empty()) {
+      Trigger("Brownout");
+    }
+    instance.m_WasBrownedOut = robotController.brownedOut;
+  }
+
+  void LogProcess() {
+    if (!IsEnabled()) {
+      return;
+    }
+
+    BearLog& instance = GetInstance();
+    ProcessSnapshot& process = instance.m_ProcessSnapshot;
+    if (!process.Read()) {
+      return;
+    }
 
-    BearLog::Log(kPdhPrefix + "Temperature(C)", GetInstance().m_Pdh->GetTemperature());
-    BearLog::Log(kPdhPrefix + "Voltage(V)", GetInstance().m_Pdh->GetVoltage());
-    BearLog::Log(kPdhPrefix + "ChannelCurrent(A)", GetInstance().m_Pdh->GetAllCurrents());
-    BearLog::Log(kPdhPrefix + "TotalCurrent(A)", GetInstance().m_Pdh->GetTotalCurrent());
-    BearLog::Log(kPdhPrefix + "TotalPower(W)", GetInstance().m_Pdh->GetTotalPower());
-    BearLog::Log(kPdhPrefix + "TotalEnergy(J)", GetInstance().m_Pdh->GetTotalEnergy());
-    BearLog::Log(kPdhPrefix + "ChannelCount", GetInstance().m_Pdh->GetNumChannels());
+    static const std::string kProcessPrefix = "SystemStats/Process/";
+    static Entry<double> cpuEntry{kProcessPrefix + "CPU(%)"};
+    static Entry<double> memoryEntry{kProcessPrefix + "Memory(MB)"};
+    static Entry<int64_t> threadsEntry{kProcessPrefix + "Threads"};
+
+    cpuEntry.Log(process.cpuPercent);
+    memoryEntry.Log(process.residentMegabytes);
+    threadsEntry.Log(process.threadCount);
   }
 
   static void SetPdh(std::shared_ptr<frc::PowerDistribution> powerDistribution) {
@@ -119,14 +478,15 @@ public:
   }
 
   static void SetEnabled(bool newEnabled) {
+    const std::lock_guard<std::mutex> lock(GetInstance().m_OptionsMutex);
     GetInstance().m_IsEnabled = newEnabled;
 
     if (newEnabled) {
       // Start logging extras if that option is selected and BearLog is being enabled
       StartLoggingExtrasIfNeeded();
     } else {
-      // When disabling logging, be sure to stop the internal notifier for the extras
-      GetInstance().m_InternalLogNotifier.Stop();
+      // When disabling logging, be sure to stop the internal notifiers for the extras
+      StopLoggingExtras();
     }
   }
 
@@ -134,123 +494,1528 @@ public:
     return GetInstance().m_IsEnabled;
   }
 
-  static void Log(std::string key, bool value) {
-    if (!IsEnabled()) {
-      return;
+  /**
+   * Capture the time once and use it for every value logged on this thread until EndCycle() is called. All the
+   * values from one robot loop then share exactly the same timestamp, and only one FPGA time read is needed for
+   * the whole loop. Values logged on other threads, or on this thread outside of a cycle, are still stamped when
+   * they are logged.
+   */
+  static void BeginCycle() {
+    CycleTimestamp() = frc::RobotController::GetFPGATime();
+  }
+
+  static void EndCycle() {
+    FlushProfile();
+    CycleTimestamp() = 0;
+
+    BearLog& instance = GetInstance();
+    if (instance.m_Stats.IsEnabled()) {
+      instance.m_Stats.LatchCycle();
+    }
+
+    // Apply whatever was staged even if the options changed during the cycle, so nothing is left behind
+    NetworkTablesBatch& batch = GetNetworkTablesBatch();
+    if (!batch.IsEmpty()) {
+      batch.Apply();
+    }
+    if (GetOptions().GetNetworkTablesFlush() == BearLogOptions::NTFlush::EveryCycle) {
+      nt::NetworkTableInstance::GetDefault().Flush();
+    }
+  }
+
+  /**
+   * Scoped version of BeginCycle() and EndCycle(). Put one at the top of RobotPeriodic():
+   *
+   *   BearLog::Cycle cycle;
+   */
+  class Cycle {
+  public:
+    Cycle() {
+      BeginCycle();
+    }
+
+    ~Cycle() {
+      EndCycle();
     }
 
-    uint64_t now = frc::RobotController::GetFPGATime();
+    Cycle(const Cycle&) = delete;
+    Cycle& operator=(const Cycle&) = delete;
+  };
 
-    GetInstance().m_DataLogger.Log(now, key, value);
-    if (GetInstance().m_Options.ShouldPublishToNetworkTables()) {
-      GetInstance().m_NTLogger.Log(now, key, value);
+  /**
+   * Time a block of code:
+   *
+   *   void Drive::Periodic() {
+   *     BearLog::ScopedTimer timer("Drive/Periodic");
+   *     ...
+   *   }
+   *
+   * Times are added up per thread and logged once per cycle, when EndCycle() runs on the same thread, as
+   * "Profile/<name>" = [total (ms), count, max (ms)]. Scopes that start outside of a cycle are ignored, since
+   * nothing would ever log them. Scopes can be nested, and each one reports the full time spent inside it. Looking
+   * up the name costs a hash per scope, which BEARLOG_PROFILE_SCOPE() avoids.
+   */
+  class ScopedTimer {
+  public:
+    explicit ScopedTimer(std::string_view name) : ScopedTimer(GetProfileScope(name)) {}
+
+    explicit ScopedTimer(const ProfileScope& scope)
+        : m_Scope(scope), m_InCycle(CycleTimestamp() != 0),
+          m_Start(m_InCycle ? Profiler::Clock::now() : Profiler::Clock::time_point()) {}
+
+    ~ScopedTimer() {
+      if (!m_InCycle) {
+        return;
+      }
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Profiler::Clock::now() - m_Start);
+      Profiler::Record(m_Scope, static_cast<uint64_t>(elapsed.count()));
     }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    const ProfileScope& m_Scope;
+    const bool m_InCycle;
+    const Profiler::Clock::time_point m_Start;
+  };
+
+  static const ProfileScope& GetProfileScope(std::string_view name) {
+    return GetInstance().m_Profiler.GetScope(name);
   }
 
-  static void Log(std::string key, const std::vector<double>& value) {
-    if (!IsEnabled()) {
-      return;
+  static const ProfileScope& GetProfileScope(std::source_location location = std::source_location::current()) {
+    return GetInstance().m_Profiler.GetScope(location);
+  }
+
+  /**
+   * Give one key its own change filter instead of the one from the options. Set it before the key is first
+   * logged, e.g. in the Robot constructor.
+   */
+  static void SetChangeFilter(std::string_view key, ChangeFilter filter) {
+    const std::lock_guard<std::mutex> lock(GetInstance().m_ChangeFilterMutex);
+
+    GetInstance().m_KeyChangeFilters.insert_or_assign(std::string(key), filter);
+  }
+
+  /**
+   * Replace the key filter rules. See KeyFilter for the rule format. Keys re-check the new rules the next time
+   * they are logged.
+   */
+  static void SetKeyFilter(std::span<const std::string> rules) {
+    auto keyFilter = std::make_shared<const KeyFilter>(rules);
+
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_KeyFilterMutex);
+
+    instance.m_KeyFilter = std::move(keyFilter);
+    instance.m_KeyFilterGeneration.fetch_add(1, std::memory_order_release);
+  }
+
+  /**
+   * Load key filter rules from a file with one rule per line. By default this reads bearlog_filter.txt from the
+   * deploy directory, which is src/main/deploy in the robot project. Returns false if the file couldn't be read.
+   */
+  static bool LoadKeyFilterFile(std::string path = "") {
+    if (path.empty()) {
+      path = frc::filesystem::GetDeployDirectory() + "/" + std::string(kKeyFilterFileName);
     }
 
-    uint64_t now = frc::RobotController::GetFPGATime();
+    std::ifstream file(path);
+    if (!file) {
+      return false;
+    }
 
-    GetInstance().m_DataLogger.Log(now, key, value);
-    if (GetInstance().m_Options.ShouldPublishToNetworkTables()) {
-      GetInstance().m_NTLogger.Log(now, key, value);
+    std::vector<std::string> rules;
+    for (std::string line; std::getline(file, line);) {
+      rules.push_back(line);
     }
+
+    SetKeyFilter(rules);
+    return true;
   }
 
-  static void Log(std::string key, double value) {
-    if (!IsEnabled()) {
-      return;
+  /**
+   * Watch a NetworkTables string array topic for key filter rules, so keys can be turned on and off from a
+   * dashboard while the robot is running. Each time the topic changes, its value replaces the current rules.
+   */
+  static void ListenForKeyFilter(std::string_view topicName = kKeyFilterTopic) {
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_KeyFilterMutex);
+
+    if (instance.m_KeyFilterListener != 0) {
+      nt::RemoveListener(instance.m_KeyFilterListener);
     }
 
-    uint64_t now = frc::RobotController::GetFPGATime();
+    instance.m_KeyFilterSubscriber =
+        nt::NetworkTableInstance::GetDefault().GetStringArrayTopic(topicName).Subscribe({});
+    instance.m_KeyFilterListener = nt::AddListener(
+        instance.m_KeyFilterSubscriber.GetHandle(), nt::EventFlags::kValueAll, [](const nt::Event& event) {
+          if (const nt::ValueEventData* valueData = event.GetValueEventData()) {
+            if (valueData->value.IsStringArray()) {
+              SetKeyFilter(valueData->value.GetStringArray());
+            }
+          }
+        });
+  }
 
-    GetInstance().m_DataLogger.Log(now, key, value);
-    if (GetInstance().m_Options.ShouldPublishToNetworkTables()) {
-      GetInstance().m_NTLogger.Log(now, key, value);
+  /**
+   * Register a key before its first value is logged, so that its log entry and NetworkTables topic are created
+   * during startup instead of the first time a rare code path runs, like the first climb of a match. Use the type
+   * the key will be logged with:
+   *
+   *   BearLog::Preregister<double>("Climber/Angle");
+   *   BearLog::Preregister<units::meter_t>("Elevator/Height");
+   *   BearLog::Preregister<frc::Pose2d>("Climber/TargetPose");
+   */
+  template<typename Value>
+  static void Preregister(std::string_view key) {
+    if constexpr (UnitType<Value>) {
+      PreregisterSlot<double>(std::string(key) + std::string(UnitSuffix<Value>::kValue), nullptr);
+    } else if constexpr (wpi::StructSerializable<Value>) {
+      PreregisterSlot<PackedStruct>(key, &GetStructTypeInfo<Value, false>());
+    } else if constexpr (StructRange<Value>) {
+      PreregisterSlot<PackedStruct>(key, &GetStructTypeInfo<std::ranges::range_value_t<Value>, true>());
+    } else {
+      PreregisterSlot<typename LoggedTypeOf<Value>::Type>(key, nullptr);
     }
   }
 
-  static void Log(std::string key, int value) {
-    if (!IsEnabled()) {
-      return;
+  /**
+   * Make room for this many keys in total up front, so registering them never has to grow the key table.
+   */
+  static void ReserveKeys(size_t count) {
+    GetInstance().m_Registry.Reserve(count);
+  }
+
+  /**
+   * Preregister every key in a manifest file. Each line is a .wpilog type and a key, like "double Climber/Angle".
+   * By default this reads bearlog_manifest.txt from the log directory, where SaveKeyManifest() writes it, or from
+   * the deploy directory if the last run didn't save one. Struct keys can't be registered by name and are skipped,
+   * so preregister those in code. Returns false if the file couldn't be read.
+   */
+  static bool LoadKeyManifest(std::string path = "") {
+    if (path.empty()) {
+      path = GetSavedManifestPath();
+      if (!std::ifstream(path)) {
+        path = frc::filesystem::GetDeployDirectory() + "/" + std::string(kKeyManifestFileName);
+      }
+    }
+
+    std::ifstream file(path);
+    if (!file) {
+      return false;
+    }
+
+    std::vector<std::pair<LogType, std::string>> keys;
+    for (std::string line; std::getline(file, line);) {
+      // Trim the '\r' from files saved on Windows
+      line.erase(line.find_last_not_of(" \t\r\n") + 1);
+      if (line.empty() || line.starts_with('#')) {
+        continue;
+      }
+
+      size_t separator = line.find(' ');
+      if (separator == std::string::npos) {
+        continue;
+      }
+      if (std::optional<LogType> type = ParseDataLogTypeString(std::string_view(line).substr(0, separator))) {
+        keys.emplace_back(*type, line.substr(separator + 1));
+      }
     }
 
-    uint64_t now = frc::RobotController::GetFPGATime();
+    ReserveKeys(GetInstance().m_Registry.Size() + keys.size());
+    for (const auto& [type, key] : keys) {
+      PreregisterType(type, key);
+    }
+    return true;
+  }
 
-    GetInstance().m_DataLogger.Log(now, key, value);
-    if (GetInstance().m_Options.ShouldPublishToNetworkTables()) {
-      GetInstance().m_NTLogger.Log(now, key, value);
+  /**
+   * Write every key logged so far to a manifest file that LoadKeyManifest() can read on the next run. Calling it
+   * from DisabledInit() keeps the manifest up to date with every key the robot has used. By default it goes in
+   * DataLogManager's log directory, next to the log files, so simulation never writes into the source tree.
+   * Returns false if the file couldn't be written.
+   */
+  static bool SaveKeyManifest(std::string path = "") {
+    if (path.empty()) {
+      path = GetSavedManifestPath();
     }
+
+    // Build the contents first so that the registry isn't locked while writing the file
+    std::string manifest = "# Written by BearLog. Each line is the type and key of one logged value.\n";
+    GetInstance().m_Registry.ForEach([&](std::string_view key, LogSlot& registered) {
+      // Keys logged with more than one type are left out, so the next run doesn't fix whichever type came first
+      const LogSlot& slot = *ResolveSlot(&registered);
+      if (!slot.structInfo && !slot.typeMismatchReported.load(std::memory_order_relaxed)) {
+        manifest += GetDataLogTypeString(slot.type);
+        manifest += ' ';
+        manifest += key;
+        manifest += '\n';
+      }
+    });
+
+    std::ofstream file(path);
+    file << manifest;
+    return static_cast<bool>(file);
   }
 
-  static void Log(std::string key, std::span<const std::string> value) {
+  /**
+   * Write everything the flight recorders are holding to the log file, with the values' original timestamps, and
+   * log the reason to "BearLog/Trigger". Call it when something goes wrong:
+   *
+   *   if (m_elevatorMotor.GetFault_Hardware().GetValue()) {
+   *     BearLog::Trigger("Elevator hardware fault");
+   *   }
+   *
+   * The recorders start filling up again straight away, so a later trigger only writes values recorded since
+   * this one. Writing the values doesn't allocate.
+   */
+  static void Trigger(std::string_view reason) {
     if (!IsEnabled()) {
       return;
     }
 
-    uint64_t now = frc::RobotController::GetFPGATime();
+    BearLog& instance = GetInstance();
+    {
+      const std::lock_guard<std::mutex> lock(instance.m_FlightRecorderMutex);
 
-    GetInstance().m_DataLogger.Log(now, key, value);
-    if (GetInstance().m_Options.ShouldPublishToNetworkTables()) {
-      GetInstance().m_NTLogger.Log(now, key, value);
+      for (auto& [slot, key] : instance.m_FlightRecorderSlots) {
+        DumpFlightRecorder(*slot, key);
+      }
     }
+
+    LogToWriters<std::string>(kTriggerKey, reason);
   }
 
-  static void Log(std::string key, const std::string& value) {
-    if (!IsEnabled()) {
-      return;
+  /**
+   * Number of values that weren't written because they hadn't changed since the last value written.
+   */
+  static uint64_t GetSuppressedWriteCount() {
+    return GetInstance().m_SuppressedWrites.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Number of values thrown away because the async queue was full. Always 0 when async logging has never been on.
+   */
+  static uint64_t GetDroppedRecordCount() {
+    uint64_t dropped = GetInstance().m_RetiredDroppedRecords.load(std::memory_order_relaxed);
+    WithAsyncWriter([&](AsyncLogWriter& writer) { dropped += writer.GetDroppedRecordCount(); });
+    return dropped;
+  }
+
+  /**
+   * Write to this DataLog instead of DataLogManager's, like a wpi::log::DataLogBackgroundWriter for a file of its
+   * own. BearLog keeps it open until shutdown. Entries can't move between logs, so this only works before the
+   * first value is written to the DataLog. Returns false, and reports an error, if it was called too late.
+   */
+  static bool SetDataLog(std::unique_ptr<wpi::log::DataLog> log) {
+    BearLog& instance = GetInstance();
+    if (!instance.m_DataLogger.SetLog(*log)) {
+      FRC_ReportError(frc::err::Error, "BearLog: SetDataLog() was called after values were already written to the "
+                      "DataLog. Call it before anything is logged.");
+      return false;
     }
+    // Only the first call can get here
+    instance.m_DataLog = std::move(log);
+    return true;
+  }
 
-    uint64_t now = frc::RobotController::GetFPGATime();
+  /**
+   * Also write every value that goes to the log file to a sink, from now on. Keys already logged are started in
+   * the sink the next time they are written. Up to kMaxLogSinks sinks can be added at once. Returns false if that
+   * many are already added.
+   *
+   *   auto sink = std::make_shared<MemorySink>();
+   *   BearLog::AddSink(sink);
+   */
+  static bool AddSink(std::shared_ptr<BearLogSink> sink) {
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_SinkMutex);
 
-    GetInstance().m_DataLogger.Log(now, key, value);
-    if (GetInstance().m_Options.ShouldPublishToNetworkTables()) {
-      GetInstance().m_NTLogger.Log(now, key, value);
+    for (std::atomic<SinkHandle*>& slot : instance.m_Sinks) {
+      if (slot.load(std::memory_order_relaxed) == nullptr) {
+        SinkHandle& handle = instance.m_SinkHandles.emplace_back(SinkHandle{std::move(sink), instance.m_NextSinkId++});
+        slot.store(&handle, std::memory_order_release);
+        instance.m_SinkCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
     }
+    return false;
   }
 
-  template<typename Units>
-  static void Log(std::string key, Units value) {
-    if (!IsEnabled()) {
-      return;
+  /**
+   * Stop writing to a sink and flush it. A value being logged on another thread right now may still reach the sink,
+   * so BearLog holds a reference to it until shutdown.
+   */
+  static void RemoveSink(const std::shared_ptr<BearLogSink>& sink) {
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_SinkMutex);
+
+    for (std::atomic<SinkHandle*>& slot : instance.m_Sinks) {
+      SinkHandle* handle = slot.load(std::memory_order_relaxed);
+      if (handle && handle->sink == sink) {
+        slot.store(nullptr, std::memory_order_release);
+        instance.m_SinkCount.fetch_sub(1, std::memory_order_relaxed);
+        sink->Flush();
+      }
     }
+  }
+
+  static void Log(std::string_view key, bool value) {
+    LogToWriters<bool>(key, value);
+  }
 
-    // @todo Add a better compiler error message when the Units class doesn't support the necessary functions
+  static void Log(std::string_view key, std::span<const double> value) {
+    LogToWriters<std::vector<double>>(key, value);
+  }
+
+  static void Log(std::string_view key, std::span<const float> value) {
+    LogToWriters<std::vector<float>>(key, value);
+  }
+
+  static void Log(std::string_view key, std::span<const int64_t> value) {
+    LogToWriters<std::vector<int64_t>>(key, value);
+  }
+
+  static void Log(std::string_view key, std::span<const bool> value) {
+    LogToWriters<std::vector<bool>>(key, value);
+  }
+
+  static void Log(std::string_view key, double value) {
+    LogToWriters<double>(key, value);
+  }
+
+  static void Log(std::string_view key, int value) {
+    LogToWriters<int64_t>(key, value);
+  }
+
+  static void Log(std::string_view key, std::span<const std::string> value) {
+    LogToWriters<std::vector<std::string>>(key, value);
+  }
+
+  static void Log(std::string_view key, const std::string& value) {
+    LogToWriters<std::string>(key, value);
+  }
 
-    uint64_t now = frc::RobotController::GetFPGATime();
+  /**
+   * Log any contiguous container, like a std::vector or std::array, straight from its memory without copying it
+   * into a temporary vector first.
+   */
+  template<std::ranges::contiguous_range Range>
+    requires ArrayElement<std::ranges::range_value_t<Range>> ||
+             wpi::StructSerializable<std::ranges::range_value_t<Range>>
+  static void Log(std::string_view key, const Range& value) {
+    using Element = std::ranges::range_value_t<Range>;
 
-    std::string key_with_units = key + "(" + value.abbreviation() + ")";
+    Log(key, std::span<const Element>(std::ranges::data(value), std::ranges::size(value)));
+  }
 
-    GetInstance().m_DataLogger.Log(now, key_with_units, value.value());
-    if (GetInstance().m_Options.ShouldPublishToNetworkTables()) {
-      GetInstance().m_NTLogger.Log(now, key_with_units, value.value());
+  /**
+   * Log any type with a wpi::Struct specialization, like frc::Pose2d or frc::SwerveModuleState, as one packed
+   * record instead of one key per field. All the fields land in the log with the same timestamp, so AdvantageScope
+   * never shows half of an update. The struct's schema is added to the log and NetworkTables the first time the
+   * key is logged.
+   */
+  template<wpi::StructSerializable S>
+  static void Log(std::string_view key, const S& value) {
+    if (IsEnabled()) {
+      LogToWriters<PackedStruct>(key, PackStructValue(value));
     }
   }
 
-private:
-  // Make the constructor private to disallow direct instantiation of BearLog
-  BearLog()
-      : m_IsEnabled(true),
-        m_DataLogger(kLogTable),
-        m_NTLogger(kLogTable),
-        m_InternalLogNotifier(&BearLog::LogExtras, this) {
+  template<wpi::StructSerializable S>
+  static void Log(std::string_view key, std::span<const S> value) {
+    if (IsEnabled()) {
+      LogToWriters<PackedStruct>(key, PackStructArray(value));
+    }
   }
 
-  static BearLog& GetInstance() {
-    static BearLog instance;
-    return instance;
+  template<UnitType Units>
+  static void Log(std::string_view key, Units value) {
+    if (!IsEnabled()) {
+      return;
+    }
+
+    // The suffix is a compile time constant, so this only copies the key. Reusing a per-thread buffer means the
+    // copy doesn't allocate once the buffer has grown to fit the longest key.
+    thread_local std::string key_with_units;
+    key_with_units.assign(key);
+    key_with_units += UnitSuffix<Units>::kValue;
+
+    LogToWriters<double>(key_with_units, value.value());
   }
 
-  // Mutex to protect multiple threads accessing m_Pdh
-  std::mutex m_PdhMutex;
+  /**
+   * Log a value that is only computed if it is actually going to be written. The callable is skipped when
+   * logging is disabled, when the key is filtered out, or when every sink would throw the value away because of
+   * a rate limit:
+   *
+   *   BearLog::Log("Vision/Residuals", [&] { return ComputeResiduals(); });
+   *
+   * BEARLOG_LAZY("Vision/Residuals", ComputeResiduals()) is shorthand for the same thing.
+   */
+  template<typename Compute>
+    requires std::invocable<Compute&>
+  static void Log(std::string_view key, Compute&& compute) {
+    using Value = std::decay_t<std::invoke_result_t<Compute&>>;
 
-  bool m_IsEnabled;
-  DataLogWriter m_DataLogger;
-  NetworkTablesWriter m_NTLogger;
-  BearLogOptions m_Options;
-  std::shared_ptr<frc::PowerDistribution> m_Pdh;
-  frc::Notifier m_InternalLogNotifier;
-};
\ No newline at end of file
+    if constexpr (UnitType<Value>) {
+      thread_local std::string key_with_units;
+      key_with_units.assign(key);
+      key_with_units += UnitSuffix<Value>::kValue;
+
+      if (WillWrite<double>(key_with_units)) {
+        Log(key, compute());
+      }
+    } else {
+      if (WillWrite<typename LoggedTypeOf<Value>::Type>(key)) {
+        Log(key, compute());
+      }
+    }
+  }
+
+  /**
+   * A handle to a single key. The key is looked up the first time a value is logged, and never again after that.
+   */
+  template<typename T>
+  class Entry {
+  public:
+    explicit Entry(std::string key) : m_Key(std::move(key)) {}
+
+    void Log(typename LogTypeTraits<T>::ValueParam value) {
+      if (IsEnabled()) {
+        LogToCachedSlot<T>(m_Key, m_Slot, value);
+      }
+    }
+
+    /**
+     * Only compute the value if it is going to be written. See the lazy version of BearLog::Log().
+     */
+    template<typename Compute>
+      requires std::invocable<Compute&>
+    void Log(Compute&& compute) {
+      if (IsEnabled() && WillWriteCachedSlot<T>(m_Key, m_Slot)) {
+        Log(compute());
+      }
+    }
+
+    const std::string& GetKey() const {
+      return m_Key;
+    }
+
+  private:
+    const std::string m_Key;
+    std::atomic<LogSlot*> m_Slot{nullptr};
+  };
+
+  /**
+   * Handle for a units value. The unit abbreviation is added to the key once when the handle is created, so
+   * Entry<units::meter_t>{"Elevator/Height"} logs to "Elevator/Height(m)" without building that string again.
+   */
+  template<UnitType Units>
+  class Entry<Units> {
+  public:
+    explicit Entry(std::string_view key) : m_Entry(std::string(key) + std::string(UnitSuffix<Units>::kValue)) {}
+
+    void Log(Units value) {
+      m_Entry.Log(value.value());
+    }
+
+    const std::string& GetKey() const {
+      return m_Entry.GetKey();
+    }
+
+  private:
+    Entry<double> m_Entry;
+  };
+
+  /**
+   * Handle for a struct type, e.g. Entry<frc::Pose2d>{"Drive/Pose"}.
+   */
+  template<wpi::StructSerializable S>
+  class Entry<S> {
+  public:
+    explicit Entry(std::string key) : m_Entry(std::move(key)) {}
+
+    void Log(const S& value) {
+      if (BearLog::IsEnabled()) {
+        m_Entry.Log(PackStructValue(value));
+      }
+    }
+
+    const std::string& GetKey() const {
+      return m_Entry.GetKey();
+    }
+
+  private:
+    Entry<PackedStruct> m_Entry;
+  };
+
+  /**
+   * A handle for every key under one prefix, like a subsystem's name. The prefix is joined to each key once, the
+   * first time that key is logged, and after that the logger finds the key's slot in its own small registry by the
+   * short key alone. Keep one per subsystem:
+   *
+   *   BearLog::Logger m_log = BearLog::Sub("Elevator");
+   *   m_log.Log("Height", m_height); // Logs to "Elevator/Height(m)"
+   *
+   * Keys logged through a logger are the same keys as logging the full path with BearLog::Log(), so the two can be
+   * mixed freely.
+   */
+  class Logger {
+  public:
+    explicit Logger(std::string_view prefix)
+        : m_Prefix(std::string(prefix) + "/"), m_Entries(std::make_unique<ConcurrentKeyRegistry<CachedKey>>()) {}
+
+    /**
+     * A logger for keys under a table inside this one, e.g. BearLog::Sub("Elevator").Sub("Motor").
+     */
+    Logger Sub(std::string_view name) const {
+      return Logger(m_Prefix + std::string(name));
+    }
+
+    void Log(std::string_view key, bool value) {
+      LogToKey<bool>(key, value);
+    }
+
+    void Log(std::string_view key, std::span<const double> value) {
+      LogToKey<std::vector<double>>(key, value);
+    }
+
+    void Log(std::string_view key, std::span<const float> value) {
+      LogToKey<std::vector<float>>(key, value);
+    }
+
+    void Log(std::string_view key, std::span<const int64_t> value) {
+      LogToKey<std::vector<int64_t>>(key, value);
+    }
+
+    void Log(std::string_view key, std::span<const bool> value) {
+      LogToKey<std::vector<bool>>(key, value);
+    }
+
+    void Log(std::string_view key, double value) {
+      LogToKey<double>(key, value);
+    }
+
+    void Log(std::string_view key, int value) {
+      LogToKey<int64_t>(key, value);
+    }
+
+    void Log(std::string_view key, std::span<const std::string> value) {
+      LogToKey<std::vector<std::string>>(key, value);
+    }
+
+    void Log(std::string_view key, const std::string& value) {
+      LogToKey<std::string>(key, value);
+    }
+
+    template<std::ranges::contiguous_range Range>
+      requires ArrayElement<std::ranges::range_value_t<Range>> ||
+               wpi::StructSerializable<std::ranges::range_value_t<Range>>
+    void Log(std::string_view key, const Range& value) {
+      using Element = std::ranges::range_value_t<Range>;
+
+      Log(key, std::span<const Element>(std::ranges::data(value), std::ranges::size(value)));
+    }
+
+    template<wpi::StructSerializable S>
+    void Log(std::string_view key, const S& value) {
+      if (IsEnabled()) {
+        LogToKey<PackedStruct>(key, PackStructValue(value));
+      }
+    }
+
+    template<wpi::StructSerializable S>
+    void Log(std::string_view key, std::span<const S> value) {
+      if (IsEnabled()) {
+        LogToKey<PackedStruct>(key, PackStructArray(value));
+      }
+    }
+
+    template<UnitType Units>
+    void Log(std::string_view key, Units value) {
+      if (IsEnabled()) {
+        LogToKey<double>(GetKeyWithUnits<Units>(key), value.value());
+      }
+    }
+
+    /**
+     * Only compute the value if it is going to be written. See the lazy version of BearLog::Log().
+     */
+    template<typename Compute>
+      requires std::invocable<Compute&>
+    void Log(std::string_view key, Compute&& compute) {
+      using Value = std::decay_t<std::invoke_result_t<Compute&>>;
+
+      if (!IsEnabled()) {
+        return;
+      }
+
+      if constexpr (UnitType<Value>) {
+        CachedKey& cachedKey = GetCachedKey(GetKeyWithUnits<Value>(key));
+        if (WillWriteCachedSlot<double>(cachedKey.key, cachedKey.slot)) {
+          Log(key, compute());
+        }
+      } else {
+        CachedKey& cachedKey = GetCachedKey(key);
+        if (WillWriteCachedSlot<typename LoggedTypeOf<Value>::Type>(cachedKey.key, cachedKey.slot)) {
+          Log(key, compute());
+        }
+      }
+    }
+
+    // Includes the trailing '/'
+    const std::string& GetPrefix() const {
+      return m_Prefix;
+    }
+
+  private:
+    // A key under this logger's prefix, and its slot once it has been resolved
+    struct CachedKey {
+      const std::string key;
+      std::atomic<LogSlot*> slot{nullptr};
+    };
+
+    // Same per-thread buffer as BearLog::Log() for units
+    template<UnitType Units>
+    static std::string_view GetKeyWithUnits(std::string_view key) {
+      thread_local std::string keyWithUnits;
+      keyWithUnits.assign(key);
+      keyWithUnits += UnitSuffix<Units>::kValue;
+      return keyWithUnits;
+    }
+
+    CachedKey& GetCachedKey(std::string_view key) {
+      return m_Entries->GetOrCreate(key, [&] { return CachedKey{m_Prefix + std::string(key)}; });
+    }
+
+    template<typename T>
+    void LogToKey(std::string_view key, typename LogTypeTraits<T>::ValueParam value) {
+      if (IsEnabled()) {
+        CachedKey& cachedKey = GetCachedKey(key);
+        LogToCachedSlot<T>(cachedKey.key, cachedKey.slot, value);
+      }
+    }
+
+    std::string m_Prefix;
+    // Held by pointer so that loggers can be moved into members and containers
+    std::unique_ptr<ConcurrentKeyRegistry<CachedKey>> m_Entries;
+  };
+
+  /**
+   * A logger whose keys all start with "prefix/".
+   */
+  static Logger Sub(std::string_view prefix) {
+    return Logger(prefix);
+  }
+
+private:
+  // An added sink. The id tells a slot's entries for this sink apart from ones started for a removed sink that
+  // was in the same place.
+  struct SinkHandle {
+    std::shared_ptr<BearLogSink> sink;
+    uint32_t id;
+  };
+
+  // Where SaveKeyManifest() writes by default, next to the log files
+  static std::string GetSavedManifestPath() {
+    return frc::DataLogManager::GetLogDir() + "/" + std::string(kKeyManifestFileName);
+  }
+
+  // 0 when this thread is not inside a cycle
+  static uint64_t& CycleTimestamp() {
+    thread_local uint64_t timestamp = 0;
+    return timestamp;
+  }
+
+  // This thread's NetworkTables values waiting for the end of its cycle
+  static NetworkTablesBatch& GetNetworkTablesBatch() {
+    thread_local NetworkTablesBatch batch;
+    return batch;
+  }
+
+  static uint64_t GetTimestamp() {
+    uint64_t cycleTimestamp = CycleTimestamp();
+    return cycleTimestamp != 0 ? cycleTimestamp : frc::RobotController::GetFPGATime();
+  }
+
+  // Log one value for each scope this thread timed during the cycle
+  static void FlushProfile() {
+    Profiler::Flush([](const ProfileScope& scope, const ProfileAccumulator& accumulator) {
+      const double value[] = {accumulator.totalNanos / 1e6, static_cast<double>(accumulator.count),
+                              accumulator.maxNanos / 1e6};
+      Log(scope.key, std::span<const double>(value));
+    });
+  }
+
+  template<typename T>
+  static void LogToWriters(std::string_view key, typename LogTypeTraits<T>::ValueParam value) {
+    if (!IsEnabled()) {
+      return;
+    }
+
+    BearLog& instance = GetInstance();
+    LogStats::CallTimer timer(instance.m_Stats);
+    uint64_t now = GetTimestamp();
+
+    if (!WithAsyncWriter([&](AsyncLogWriter& writer) { writer.Push(now, key, value); })) {
+      WriteToWriters<T>(now, key, value);
+    }
+  }
+
+  template<typename T>
+  static void WriteToWriters(uint64_t timestamp, std::string_view key, typename LogTypeTraits<T>::ValueParam value) {
+    LogSlot* slot = GetSlot<T>(timestamp, key, GetStructInfo<T>(value));
+    if (slot && IsKeyEnabled(*slot, key)) {
+      WriteToSlot<T>(*slot, key, timestamp, value);
+    }
+  }
+
+  /**
+   * Log through a slot that the caller caches between calls, like an Entry's. The key must stay alive as long as
+   * the cache does, since async mode and the key filter read it.
+   */
+  template<typename T>
+  static void LogToCachedSlot(const std::string& key, std::atomic<LogSlot*>& cachedSlot,
+                              typename LogTypeTraits<T>::ValueParam value) {
+    BearLog& instance = GetInstance();
+    LogStats::CallTimer timer(instance.m_Stats);
+
+    // Once resolved, a key that is filtered out returns here without reading the time or touching the key
+    LogSlot* slot = cachedSlot.load(std::memory_order_acquire);
+    if (slot && !IsKeyEnabled(*slot, key)) {
+      return;
+    }
+
+    uint64_t now = GetTimestamp();
+
+    // A Logger's key can be logged with more than one type, so recheck the type of a cached slot and let GetSlot()
+    // report the mismatch
+    if (slot && !HasType<T>(*slot, value)) {
+      slot = nullptr;
+    }
+
+    auto push = [&](AsyncLogWriter& writer) { PushToCachedSlot<T>(writer, key, cachedSlot, slot, now, value); };
+    if (WithAsyncWriter(push)) {
+      return;
+    }
+
+    // The same cache can be shared between threads. Resolving it twice is harmless since the registry hands back
+    // the same slot for the same key, so a plain atomic store is enough.
+    if (!slot) {
+      slot = GetSlot<T>(now, key, GetStructInfo<T>(value));
+      if (!slot) {
+        return;
+      }
+      cachedSlot.store(slot, std::memory_order_release);
+
+      if (!IsKeyEnabled(*slot, key)) {
+        return;
+      }
+    }
+
+    WriteToSlot<T>(*slot, key, now, value);
+  }
+
+  /**
+   * New keys are registered on the writer thread in async mode, so until the writer has made the slot, values are
+   * pushed by key and the producer looks for the slot again next time.
+   */
+  template<typename T>
+  static void PushToCachedSlot(AsyncLogWriter& writer, const std::string& key, std::atomic<LogSlot*>& cachedSlot,
+                               LogSlot* slot, uint64_t timestamp, typename LogTypeTraits<T>::ValueParam value) {
+    if (!slot) {
+      slot = ResolveSlot(GetInstance().m_Registry.Find(key));
+      // The writer thread registers the key, or settles the type of a preregistered one
+      if (!slot || slot->state.load(std::memory_order_acquire) != SlotState::Logged || !HasType<T>(*slot, value)) {
+        writer.Push(timestamp, key, value);
+        return;
+      }
+      cachedSlot.store(slot, std::memory_order_release);
+
+      if (!IsKeyEnabled(*slot, key)) {
+        return;
+      }
+    }
+    writer.Push(timestamp, *slot, value);
+  }
+
+  template<typename T>
+  static bool HasType(const LogSlot& slot, typename LogTypeTraits<T>::ValueParam value) {
+    return slot.type == LogTypeTraits<T>::kType && slot.structInfo == GetStructInfo<T>(value);
+  }
+
+  // Let the first value through so that the key gets registered
+  template<typename T>
+  static bool WillWriteCachedSlot(std::string_view key, const std::atomic<LogSlot*>& cachedSlot) {
+    LogSlot* slot = cachedSlot.load(std::memory_order_acquire);
+    return !slot || WillWriteSlot<T>(*slot, key);
+  }
+
+  /**
+   * Find the slot for a key, registering it the first time the key is seen. Returns nullptr if the key was
+   * already logged with a different type, or with a different struct type. A key that was only preregistered
+   * takes the type of the first value logged to it.
+   */
+  template<typename T>
+  static LogSlot* GetSlot(uint64_t timestamp, std::string_view key, const StructTypeInfo* structInfo) {
+    BearLog& instance = GetInstance();
+    LogSlot* slot = &RegisterSlot<T>(key, structInfo, SlotState::Logged);
+
+    while (true) {
+      SlotState state = slot->state.load(std::memory_order_acquire);
+      if (state == SlotState::Replaced) {
+        slot = slot->replacement.load(std::memory_order_acquire);
+        continue;
+      }
+      if (state == SlotState::Replacing) {
+        // Wait for the replacement to finish
+        const std::lock_guard<std::mutex> lock(instance.m_PreregisterMutex);
+        continue;
+      }
+
+      if (slot->type == LogTypeTraits<T>::kType && slot->structInfo == structInfo) {
+        if (state == SlotState::Logged ||
+            slot->state.compare_exchange_strong(state, SlotState::Logged, std::memory_order_acq_rel)) {
+          return slot;
+        }
+      } else if (state == SlotState::Preregistered) {
+        ReplaceSlot<T>(*slot, key, structInfo, timestamp);
+      } else {
+        std::string_view typeString =
+            structInfo ? std::string_view(structInfo->typeString) : GetDataLogTypeString(LogTypeTraits<T>::kType);
+        ReportTypeMismatch(*slot, key, typeString);
+        return nullptr;
+      }
+    }
+  }
+
+  template<typename T>
+  static LogSlot& RegisterSlot(std::string_view key, const StructTypeInfo* structInfo, SlotState state) {
+    static constexpr LogType kType = LogTypeTraits<T>::kType;
+
+    BearLog& instance = GetInstance();
+    bool created = false;
+    LogSlot& slot = instance.m_Registry.GetOrCreate(key, [&](std::string_view storedKey) {
+      created = true;
+      instance.m_Stats.AddEntry(kType);
+      return LogSlot(storedKey, kType, structInfo, GetOptions().ShouldLogToDataLog(), GetKeySettings(key), state);
+    });
+
+    if (created && slot.flightRecorder) {
+      AddFlightRecorderSlot(slot, key);
+    }
+    return slot;
+  }
+
+  /**
+   * Swap a preregistered slot that nothing has been logged to for a new one of type T. Does nothing if a value of
+   * the preregistered type got there first.
+   */
+  template<typename T>
+  static void ReplaceSlot(LogSlot& slot, std::string_view key, const StructTypeInfo* structInfo,
+                          uint64_t timestamp) {
+    static constexpr LogType kType = LogTypeTraits<T>::kType;
+
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_PreregisterMutex);
+
+    SlotState expected = SlotState::Preregistered;
+    if (!slot.state.compare_exchange_strong(expected, SlotState::Replacing, std::memory_order_acq_rel)) {
+      return;
+    }
+
+    // Nothing has been written through the old slot, so its entry and topic can go before the new type starts them
+    int entry = slot.dataLogEntry.exchange(0, std::memory_order_acq_rel);
+    if (entry != 0) {
+      instance.m_DataLogger.FinishEntry(entry, timestamp);
+    }
+    NT_Publisher publisher = slot.ntPublisher.exchange(0, std::memory_order_acq_rel);
+    if (publisher != 0) {
+      nt::Release(publisher);
+    }
+    if (slot.flightRecorder) {
+      const std::lock_guard<std::mutex> flightRecorderLock(instance.m_FlightRecorderMutex);
+      std::erase_if(instance.m_FlightRecorderSlots, [&](const auto& recorded) { return recorded.first == &slot; });
+    }
+
+    instance.m_Stats.AddEntry(kType);
+    LogSlot& replacement = instance.m_ReplacedSlots.emplace_back(
+        slot.key, kType, structInfo, GetOptions().ShouldLogToDataLog(), GetKeySettings(key), SlotState::Logged);
+    if (replacement.flightRecorder) {
+      AddFlightRecorderSlot(replacement, key);
+    }
+
+    slot.replacement.store(&replacement, std::memory_order_release);
+    slot.state.store(SlotState::Replaced, std::memory_order_release);
+  }
+
+  // The slot a preregistered key's values go to, if the first one logged had another type
+  static LogSlot* ResolveSlot(LogSlot* slot) {
+    if (slot && slot->state.load(std::memory_order_acquire) == SlotState::Replaced) {
+      return slot->replacement.load(std::memory_order_acquire);
+    }
+    return slot;
+  }
+
+  static void AddFlightRecorderSlot(LogSlot& slot, std::string_view key) {
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_FlightRecorderMutex);
+    instance.m_FlightRecorderSlots.emplace_back(&slot, key);
+
+    // Sized for the largest ring, so the first dump doesn't allocate either
+    size_t capacity = slot.flightRecorder->GetCapacity();
+    if (capacity > instance.m_FlightRecorderRecords.capacity()) {
+      instance.m_FlightRecorderPayloads.reserve(capacity * sizeof(uint64_t));
+      instance.m_FlightRecorderRecords.reserve(capacity);
+    }
+  }
+
+  template<typename T>
+  static void WriteToSlot(LogSlot& slot, std::string_view key, uint64_t timestamp,
+                          typename LogTypeTraits<T>::ValueParam value) {
+    BearLog& instance = GetInstance();
+
+    if (slot.changeFilter && !slot.changeFilter->ShouldWrite<T>(value, timestamp)) {
+      instance.m_SuppressedWrites.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    if (slot.flightRecorder) {
+      // Flight recorders are only created for the types they support
+      if constexpr (FlightRecorderRing::IsSupported(LogTypeTraits<T>::kType)) {
+        slot.flightRecorder->Record<T>(value, timestamp);
+      }
+    } else if (slot.dataLogRateLimit) {
+      slot.dataLogRateLimit->Sample<T>(value, timestamp, [&](auto sample, uint64_t sampleTimestamp) {
+        WriteToFile<T>(slot, key, sampleTimestamp, sample);
+      });
+    } else {
+      WriteToFile<T>(slot, key, timestamp, value);
+    }
+
+    const BearLogOptions& options = GetOptions();
+    if (options.ShouldPublishToNetworkTables()) {
+      NT_Publisher publisher = slot.ntPublisher.load(std::memory_order_acquire);
+      if (publisher == 0) {
+        publisher = PublishSlot(slot, key);
+      }
+
+      // Only stage values logged inside a cycle, since those are the ones EndCycle() will apply
+      bool batched = options.GetNetworkTablesFlush() == BearLogOptions::NTFlush::EveryCycle &&
+                     CycleTimestamp() != 0;
+
+      auto set = [&](auto sample, uint64_t sampleTimestamp) {
+        if (batched) {
+          GetNetworkTablesBatch().Stage<T>(publisher, sample, sampleTimestamp);
+        } else {
+          instance.m_NTLogger.Set<T>(publisher, sample, sampleTimestamp);
+        }
+      };
+
+      if (slot.ntRateLimit) {
+        slot.ntRateLimit->Sample<T>(value, timestamp, set);
+      } else {
+        set(value, timestamp);
+      }
+    }
+  }
+
+  // Write a value to the DataLog and every added sink
+  template<typename T>
+  static void WriteToFile(LogSlot& slot, std::string_view key, uint64_t timestamp,
+                          typename LogTypeTraits<T>::ValueParam value) {
+    BearLog& instance = GetInstance();
+
+    if (slot.logsToDataLog) {
+      instance.m_DataLogger.Append<T>(GetDataLogEntry(slot, key, timestamp), value, timestamp);
+    }
+    instance.m_Stats.AddBytes(GetAppendedSize<T>(value));
+
+    if (instance.m_SinkCount.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+
+    // Encoded once for every sink
+    thread_local std::vector<uint8_t> buffer;
+    buffer.clear();
+    std::span<const uint8_t> payload = EncodeWpilogPayload<T>(value, buffer);
+
+    for (size_t i = 0; i < kMaxLogSinks; i++) {
+      SinkHandle* handle = instance.m_Sinks[i].load(std::memory_order_acquire);
+      if (handle) {
+        handle->sink->Append(GetSinkEntry(slot, key, i, *handle, timestamp), payload, timestamp);
+      }
+    }
+  }
+
+  /**
+   * The key's entry in the DataLog, started the first time the key is written. DataLog::Start() returns the same ID
+   * when two threads start the same key at once.
+   */
+  static int GetDataLogEntry(LogSlot& slot, std::string_view key, uint64_t timestamp) {
+    int entry = slot.dataLogEntry.load(std::memory_order_acquire);
+    if (entry == 0) {
+      entry = GetInstance().m_DataLogger.StartEntry(timestamp, key, slot.type, slot.structInfo);
+      slot.dataLogEntry.store(entry, std::memory_order_release);
+    }
+    return entry;
+  }
+
+  /**
+   * The key's entry in a sink, started the first time the key is written to it. Two threads can start the same key
+   * at once. The entry that loses the race is left empty.
+   */
+  static int GetSinkEntry(LogSlot& slot, std::string_view key, size_t index, const SinkHandle& handle,
+                          uint64_t timestamp) {
+    std::atomic<uint64_t>& sinkEntry = slot.sinkEntries[index];
+    uint64_t packed = sinkEntry.load(std::memory_order_acquire);
+    if ((packed >> 32) == handle.id) {
+      return static_cast<int>(static_cast<uint32_t>(packed));
+    }
+
+    if (slot.structInfo) {
+      slot.structInfo->forEachSchema([&](std::string_view typeString, std::string_view schema) {
+        handle.sink->AddSchema(typeString, schema, timestamp);
+      });
+    }
+    // Sinks get the same name the key has in DataLogManager's log
+    std::string name = GetInstance().m_DataLogger.GetPrefixKey(key);
+    int entry = handle.sink->StartEntry(name, slot.GetTypeString(), timestamp);
+    uint64_t started = (static_cast<uint64_t>(handle.id) << 32) | static_cast<uint32_t>(entry);
+
+    while (!sinkEntry.compare_exchange_weak(packed, started, std::memory_order_acq_rel)) {
+      if ((packed >> 32) == handle.id) {
+        return static_cast<int>(static_cast<uint32_t>(packed));
+      }
+    }
+    return entry;
+  }
+
+  /**
+   * Returns true if a value of type T logged to the key right now would be written by at least one sink.
+   */
+  template<typename T>
+  static bool WillWrite(std::string_view key) {
+    if (!IsEnabled()) {
+      return false;
+    }
+
+    // Let the first value for a key through so that the key gets registered, or gets its type if it was only
+    // preregistered
+    LogSlot* slot = ResolveSlot(GetInstance().m_Registry.Find(key));
+    return !slot || slot->state.load(std::memory_order_acquire) != SlotState::Logged || WillWriteSlot<T>(*slot, key);
+  }
+
+  template<typename T>
+  static bool WillWriteSlot(LogSlot& slot, std::string_view key) {
+    if (slot.type != LogTypeTraits<T>::kType || !IsKeyEnabled(slot, key)) {
+      return false;
+    }
+
+    if (slot.flightRecorder || (!slot.dataLogRateLimit && !slot.ntRateLimit)) {
+      return true;
+    }
+
+    uint64_t now = GetTimestamp();
+    if (!slot.dataLogRateLimit || slot.dataLogRateLimit->WantsSample<T>(now)) {
+      return true;
+    }
+    return GetOptions().ShouldPublishToNetworkTables() &&
+           (!slot.ntRateLimit || slot.ntRateLimit->WantsSample<T>(now));
+  }
+
+  static bool IsKeyEnabled(LogSlot& slot, std::string_view key) {
+    uint64_t generation = GetInstance().m_KeyFilterGeneration.load(std::memory_order_acquire);
+    uint64_t state = slot.keyFilterState.load(std::memory_order_relaxed);
+    if ((state >> 1) != generation) {
+      state = EvaluateKeyFilter(slot, key);
+    }
+    return (state & 1) != 0;
+  }
+
+  // Only called the first time a key is logged after the rules change
+  static uint64_t EvaluateKeyFilter(LogSlot& slot, std::string_view key) {
+    BearLog& instance = GetInstance();
+
+    std::shared_ptr<const KeyFilter> keyFilter;
+    uint64_t generation;
+    {
+      const std::lock_guard<std::mutex> lock(instance.m_KeyFilterMutex);
+      keyFilter = instance.m_KeyFilter;
+      generation = instance.m_KeyFilterGeneration.load(std::memory_order_relaxed);
+    }
+
+    uint64_t state = (generation << 1) | (keyFilter->IsEnabled(key) ? 1 : 0);
+    slot.keyFilterState.store(state, std::memory_order_relaxed);
+    return state;
+  }
+
+  // Only called when a key is registered, so the lock stays off of the hot path
+  static KeySettings GetKeySettings(std::string_view key) {
+    BearLog& instance = GetInstance();
+    const BearLogOptions& options = GetOptions();
+    KeySettings settings;
+
+    {
+      const std::lock_guard<std::mutex> lock(instance.m_ChangeFilterMutex);
+
+      auto it = instance.m_KeyChangeFilters.find(std::string(key));
+      if (it != instance.m_KeyChangeFilters.end()) {
+        settings.changeFilter = it->second;
+      } else {
+        settings.changeFilter = options.GetChangeFilter();
+      }
+    }
+
+    settings.dataLogRateLimit = FindPrefixRule(options.GetRateLimits(BearLogOptions::Sink::DataLog), key);
+    settings.ntRateLimit = FindPrefixRule(options.GetRateLimits(BearLogOptions::Sink::NetworkTables), key);
+    settings.flightRecorder = FindPrefixRule(options.GetFlightRecorders(), key);
+    return settings;
+  }
+
+  template<typename T>
+  static void PreregisterSlot(std::string_view key, const StructTypeInfo* structInfo) {
+    BearLog& instance = GetInstance();
+    const std::lock_guard<std::mutex> lock(instance.m_PreregisterMutex);
+
+    LogSlot* slot = ResolveSlot(&RegisterSlot<T>(key, structInfo, SlotState::Preregistered));
+    if (slot->type != LogTypeTraits<T>::kType || slot->structInfo != structInfo) {
+      ReportTypeMismatch(*slot, key, structInfo ? std::string_view(structInfo->typeString)
+                                                : GetDataLogTypeString(LogTypeTraits<T>::kType));
+      return;
+    }
+
+    // Entries are otherwise started by the first write, which is the spike preregistering is meant to avoid
+    if (slot->logsToDataLog && IsKeyEnabled(*slot, key)) {
+      GetDataLogEntry(*slot, key, GetTimestamp());
+    }
+    if (!GetOptions().ShouldPublishToNetworkTables()) {
+      return;
+    }
+
+    if (slot->ntPublisher.load(std::memory_order_acquire) == 0) {
+      PublishSlot(*slot, key);
+    }
+  }
+
+  static void PreregisterType(LogType type, std::string_view key) {
+    switch (type) {
+      case LogType::Boolean:
+        PreregisterSlot<bool>(key, nullptr);
+        break;
+      case LogType::Double:
+        PreregisterSlot<double>(key, nullptr);
+        break;
+      case LogType::Integer:
+        PreregisterSlot<int64_t>(key, nullptr);
+        break;
+      case LogType::String:
+        PreregisterSlot<std::string>(key, nullptr);
+        break;
+      case LogType::DoubleArray:
+        PreregisterSlot<std::vector<double>>(key, nullptr);
+        break;
+      case LogType::StringArray:
+        PreregisterSlot<std::vector<std::string>>(key, nullptr);
+        break;
+      case LogType::FloatArray:
+        PreregisterSlot<std::vector<float>>(key, nullptr);
+        break;
+      case LogType::IntegerArray:
+        PreregisterSlot<std::vector<int64_t>>(key, nullptr);
+        break;
+      case LogType::BooleanArray:
+        PreregisterSlot<std::vector<bool>>(key, nullptr);
+        break;
+      case LogType::Struct:
+        break;
+    }
+  }
+
+  static void DumpFlightRecorder(LogSlot& slot, std::string_view key) {
+    switch (slot.type) {
+      case LogType::Boolean:
+        DrainFlightRecorder<bool>(slot, key);
+        break;
+      case LogType::Double:
+        DrainFlightRecorder<double>(slot, key);
+        break;
+      case LogType::Integer:
+        DrainFlightRecorder<int64_t>(slot, key);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Sinks get the whole dump as one batch. Only called with m_FlightRecorderMutex held.
+  template<typename T>
+  static void DrainFlightRecorder(LogSlot& slot, std::string_view key) {
+    BearLog& instance = GetInstance();
+    bool writeToSinks = instance.m_SinkCount.load(std::memory_order_relaxed) != 0;
+
+    std::vector<uint8_t>& payloads = instance.m_FlightRecorderPayloads;
+    std::vector<SinkRecord>& records = instance.m_FlightRecorderRecords;
+    payloads.clear();
+    records.clear();
+
+    slot.flightRecorder->Drain<T>([&](typename LogTypeTraits<T>::ValueParam value, uint64_t timestamp) {
+      if (slot.logsToDataLog) {
+        instance.m_DataLogger.Append<T>(GetDataLogEntry(slot, key, timestamp), value, timestamp);
+      }
+      if (writeToSinks) {
+        EncodeWpilogPayload<T>(value, payloads);
+        records.push_back(SinkRecord{0, timestamp, {}});
+      }
+    });
+
+    if (records.empty()) {
+      return;
+    }
+
+    // Every value of these types encodes to the same size, so the payloads can be pointed at once the buffer has
+    // stopped growing
+    size_t payloadSize = payloads.size() / records.size();
+    for (size_t i = 0; i < records.size(); i++) {
+      records[i].payload = std::span<const uint8_t>(payloads).subspan(i * payloadSize, payloadSize);
+    }
+
+    for (size_t i = 0; i < kMaxLogSinks; i++) {
+      SinkHandle* handle = instance.m_Sinks[i].load(std::memory_order_acquire);
+      if (!handle) {
+        continue;
+      }
+
+      int entry = GetSinkEntry(slot, key, i, *handle, records.front().timestamp);
+      for (SinkRecord& record : records) {
+        record.entry = entry;
+      }
+      handle->sink->AppendBatch(records);
+    }
+  }
+
+  static NT_Publisher PublishSlot(LogSlot& slot, std::string_view key) {
+    BearLog& instance = GetInstance();
+    const PublishOptions* options = FindPrefixRule(GetOptions().GetPublishOptions(), key);
+    NT_Publisher publisher =
+        instance.m_NTLogger.Publish(key, slot.type, slot.structInfo, options ? options->options : nt::PubSubOptions{});
+
+    // If another thread published this key at the same time, keep its publisher and release ours
+    NT_Publisher expected = 0;
+    if (!slot.ntPublisher.compare_exchange_strong(expected, publisher, std::memory_order_acq_rel)) {
+      nt::Release(publisher);
+      return expected;
+    }
+    instance.m_Stats.AddPublisher();
+    return publisher;
+  }
+
+  static void ReportTypeMismatch(LogSlot& slot, std::string_view key, std::string_view typeString) {
+    if (slot.typeMismatchReported.exchange(true, std::memory_order_relaxed)) {
+      return;
+    }
+
+    FRC_ReportError(frc::warn::Warning, "BearLog: \"{}\" was first logged as {} and can't also be logged as {}. "
+                    "Values of the new type are being ignored.",
+                    key, slot.GetTypeString(), typeString);
+  }
+
+  /**
+   * Call push(writer) if async logging is on and return true, or return false in sync mode. The writer isn't
+   * destroyed until push returns.
+   */
+  template<typename Push>
+  static bool WithAsyncWriter(Push&& push) {
+    BearLog& instance = GetInstance();
+    // Sync mode never touches the counter
+    if (instance.m_AsyncWriter.load(std::memory_order_relaxed) == nullptr) {
+      return false;
+    }
+
+    // seq_cst on both sides, so ReplaceAsyncWriter() either counts this producer or this producer sees the writer
+    // that replaced the old one
+    instance.m_AsyncProducers.fetch_add(1, std::memory_order_seq_cst);
+    AsyncLogWriter* writer = instance.m_AsyncWriter.load(std::memory_order_seq_cst);
+    if (writer) {
+      push(*writer);
+    }
+    instance.m_AsyncProducers.fetch_sub(1, std::memory_order_release);
+    return writer != nullptr;
+  }
+
+  // Destroys the old writer, which writes out everything it still had queued, once no producer is pushing to it
+  static void ReplaceAsyncWriter(std::unique_ptr<AsyncLogWriter> writer) {
+    BearLog& instance = GetInstance();
+    std::unique_ptr<AsyncLogWriter> old(instance.m_AsyncWriter.exchange(writer.release(), std::memory_order_seq_cst));
+    if (!old) {
+      return;
+    }
+
+    while (instance.m_AsyncProducers.load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+    instance.m_RetiredDroppedRecords.fetch_add(old->GetDroppedRecordCount(), std::memory_order_relaxed);
+  }
+
+  // Called on the async writer thread for every record drained from the queue
+  static void WriteRecord(const LogRecord& record) {
+    switch (record.type) {
+      case LogType::Boolean:
+        WriteRecordValue<bool>(record, record.booleanValue);
+        break;
+      case LogType::Double:
+        WriteRecordValue<double>(record, record.doubleValue);
+        break;
+      case LogType::Integer:
+        WriteRecordValue<int64_t>(record, record.integerValue);
+        break;
+      case LogType::String:
+        WriteRecordValue<std::string>(record, record.stringValue);
+        break;
+      case LogType::DoubleArray:
+        WriteRecordValue<std::vector<double>>(record, record.doubleArrayValue);
+        break;
+      case LogType::StringArray:
+        WriteRecordValue<std::vector<std::string>>(record, record.stringArrayValue);
+        break;
+      case LogType::FloatArray:
+        WriteRecordValue<std::vector<float>>(record, record.floatArrayValue);
+        break;
+      case LogType::IntegerArray:
+        WriteRecordValue<std::vector<int64_t>>(record, record.integerArrayValue);
+        break;
+      case LogType::BooleanArray:
+        WriteRecordValue<std::vector<bool>>(record, record.GetBooleanArray());
+        break;
+      case LogType::Struct:
+        WriteRecordValue<PackedStruct>(record, record.GetStruct());
+        break;
+    }
+  }
+
+  template<typename T>
+  static void WriteRecordValue(const LogRecord& record, typename LogTypeTraits<T>::ValueParam value) {
+    // The producer already checked the slot's type and the key filter
+    if (record.slot) {
+      WriteToSlot<T>(*record.slot, record.slot->key, record.timestamp, value);
+    } else {
+      WriteToWriters<T>(record.timestamp, record.key, value);
+    }
+  }
+
+  // Make the constructor private to disallow direct instantiation of BearLog
+  BearLog()
+      : m_IsEnabled(true),
+        m_DataLogger(kLogTable),
+        m_NTLogger(kLogTable),
+        m_PdhSampler("BearLog PDH", [this] { LogPdh(); }),
+        m_RobotControllerSampler("BearLog RobotController", [this] { LogRobotController(); }),
+        m_ProcessSampler("BearLog Process", [this] { LogProcess(); }),
+        m_SelfStatsSampler("BearLog Stats", [this] { LogSelfStats(); }) {
+  }
+
+  static BearLog& GetInstance() {
+    static BearLog instance;
+    return instance;
+  }
+
+  static const BearLogOptions& GetOptions() {
+    return *GetInstance().m_Options.load(std::memory_order_acquire);
+  }
+
+  // Mutex to protect multiple threads accessing m_Pdh
+  std::mutex m_PdhMutex;
+
+  std::atomic<bool> m_IsEnabled;
+  // Set by SetDataLog(). nullptr while DataLogManager's log is used.
+  std::unique_ptr<wpi::log::DataLog> m_DataLog;
+  DataLogWriter m_DataLogger;
+  NetworkTablesWriter m_NTLogger;
+  // Mutex to protect multiple threads calling SetOptions() or SetEnabled(). Logging reads m_Options without it.
+  std::mutex m_OptionsMutex;
+  // Every set of options ever set. Never changed or shrunk, since a thread may still be reading a replaced one.
+  std::deque<BearLogOptions> m_OptionSnapshots{BearLogOptions()};
+  std::atomic<const BearLogOptions*> m_Options{&m_OptionSnapshots.front()};
+  // Every key that has been logged, shared by the DataLog and NetworkTables writers
+  ConcurrentKeyRegistry<LogSlot> m_Registry;
+  // Mutex to protect preregistering keys and replacing preregistered slots
+  std::mutex m_PreregisterMutex;
+  // Slots for preregistered keys first logged with another type. Never shrinks, like the registry.
+  std::deque<LogSlot> m_ReplacedSlots;
+  std::atomic<uint64_t> m_SuppressedWrites{0};
+  LogStats m_Stats;
+
+  // Mutex to protect multiple threads accessing m_FlightRecorderSlots
+  std::mutex m_FlightRecorderMutex;
+  // Every slot with a flight recorder and its key, so a trigger can dump them without searching the registry
+  std::vector<std::pair<LogSlot*, std::string>> m_FlightRecorderSlots;
+  // Scratch space for one dump, reserved for the largest ring when its key is registered
+  std::vector<uint8_t> m_FlightRecorderPayloads;
+  std::vector<SinkRecord> m_FlightRecorderRecords;
+
+  // Mutex to protect multiple threads adding and removing sinks. Writing to them doesn't take it.
+  std::mutex m_SinkMutex;
+  // Never shrinks, so a handle stays valid for a thread that loaded it just before its sink was removed
+  std::deque<SinkHandle> m_SinkHandles;
+  std::array<std::atomic<SinkHandle*>, kMaxLogSinks> m_Sinks{};
+  std::atomic<size_t> m_SinkCount{0};
+  // Starts at 1 so that a zeroed LogSlot::sinkEntries never matches a sink
+  uint32_t m_NextSinkId = 1;
+  Profiler m_Profiler;
+
+  // Mutex to protect multiple threads accessing m_KeyChangeFilters
+  std::mutex m_ChangeFilterMutex;
+  std::unordered_map<std::string, ChangeFilter> m_KeyChangeFilters;
+
+  // Mutex to protect multiple threads accessing m_KeyFilter and the NetworkTables listener for it
+  std::mutex m_KeyFilterMutex;
+  std::shared_ptr<const KeyFilter> m_KeyFilter = std::make_shared<const KeyFilter>();
+  // Starts at 1 so that every new slot, which has a cached generation of 0, evaluates the filter once
+  std::atomic<uint64_t> m_KeyFilterGeneration{1};
+  nt::StringArraySubscriber m_KeyFilterSubscriber;
+  NT_Listener m_KeyFilterListener = 0;
+  std::shared_ptr<frc::PowerDistribution> m_Pdh;
+
+  // Each snapshot is only touched by its own sampler's thread
+  PdhSnapshot m_PdhSnapshot;
+  RobotControllerSnapshot m_RobotControllerSnapshot;
+  ProcessSnapshot m_ProcessSnapshot;
+  bool m_WasBrownedOut = false;
+  ExtrasSampler m_PdhSampler;
+  ExtrasSampler m_RobotControllerSampler;
+  ExtrasSampler m_ProcessSampler;
+  ExtrasSampler m_SelfStatsSampler;
+  // Owned here, and read by producers without a lock through WithAsyncWriter()
+  std::atomic<AsyncLogWriter*> m_AsyncWriter{nullptr};
+  // Producers inside WithAsyncWriter(), which ReplaceAsyncWriter() waits out before destroying a writer
+  std::atomic<uint32_t> m_AsyncProducers{0};
+  // Dropped by writers that have since been replaced
+  std::atomic<uint64_t> m_RetiredDroppedRecords{0};
+};
+
+/**
+ * Log a value that is only computed if it is actually going to be written:
+ *
+ *   BEARLOG_LAZY("Drive/PoseResidual", m_poseEstimator.ComputeResidual());
+ */
+#define BEARLOG_LAZY(key, value) BearLog::Log((key), [&]() { return (value); })
+
+/**
+ * Time the rest of the enclosing block. With no name, the scope is named after the function it is in, so in
+ * Drive::Periodic() this logs to "Profile/Drive/Periodic". The scope is looked up once per call site rather than
+ * once per call. Compiled out when BEARLOG_ENABLE_PROFILING is 0.
+ */
+#if BEARLOG_ENABLE_PROFILING
+#define BEARLOG_PROFILE_CONCAT_INNER(a, b) a##b
+#define BEARLOG_PROFILE_CONCAT(a, b) BEARLOG_PROFILE_CONCAT_INNER(a, b)
+#define BEARLOG_PROFILE_SCOPE(...)                                                                   \
+  static const ProfileScope& BEARLOG_PROFILE_CONCAT(bearlogProfileScope, __LINE__) =                 \
+      BearLog::GetProfileScope(__VA_ARGS__);                                                         \
+  BearLog::ScopedTimer BEARLOG_PROFILE_CONCAT(bearlogProfileTimer, __LINE__)(                        \
+      BEARLOG_PROFILE_CONCAT(bearlogProfileScope, __LINE__))
+#else
+#define BEARLOG_PROFILE_SCOPE(...)
+#endif
\ No newline at end of file
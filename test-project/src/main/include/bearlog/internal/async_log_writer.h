@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "bearlog/internal/log_record.h"
+#include "bearlog/internal/mpsc_ring.h"
+
+/**
+ * Moves the actual writing off of the threads that call BearLog::Log. Producers only copy the value into a
+ * preallocated ring, and a background thread drains the ring in batches and hands each record to the handler.
+ */
+class AsyncLogWriter {
+public:
+  using RecordHandler = std::function<void(const LogRecord&)>;
+
+  AsyncLogWriter(size_t capacity, RingOverflowPolicy policy, RecordHandler handler)
+      : m_Ring(capacity),
+        m_Policy(policy),
+        m_Handler(std::move(handler)),
+        m_Thread(&AsyncLogWriter::Run, this) {
+  }
+
+  AsyncLogWriter(const AsyncLogWriter&) = delete;
+  AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+  ~AsyncLogWriter() {
+    {
+      const std::lock_guard<std::mutex> lock(m_WakeMutex);
+      m_Stop = true;
+    }
+    m_Wake.notify_one();
+    m_Thread.join();
+  }
+
+  template<typename Value>
+  void Push(uint64_t timestamp, std::string_view key, Value value) {
+    PushRecord(timestamp, key, nullptr, value);
+  }
+
+  // Skips copying the key, and looking it up again on the writer thread
+  template<typename Value>
+  void Push(uint64_t timestamp, LogSlot& slot, Value value) {
+    PushRecord(timestamp, {}, &slot, value);
+  }
+
+  uint64_t GetDroppedRecordCount() const {
+    return m_DroppedRecords.load(std::memory_order_relaxed);
+  }
+
+private:
+  // How long the writer thread sleeps between batches. At the default 50Hz robot loop this drains a few times
+  // per loop, which keeps the ring from backing up without burning a core.
+  static constexpr std::chrono::milliseconds kDrainPeriod{5};
+
+  template<typename Value>
+  void PushRecord(uint64_t timestamp, std::string_view key, LogSlot* slot, Value value) {
+    size_t dropped = m_Ring.Push(m_Policy, [&](LogRecord& record) {
+      record.Set(timestamp, key, value);
+      record.slot = slot;
+    });
+
+    if (dropped > 0) {
+      m_DroppedRecords.fetch_add(dropped, std::memory_order_relaxed);
+    }
+  }
+
+  void Run() {
+    while (true) {
+      bool stopping;
+      {
+        std::unique_lock<std::mutex> lock(m_WakeMutex);
+        m_Wake.wait_for(lock, kDrainPeriod, [this] { return m_Stop; });
+        stopping = m_Stop;
+      }
+
+      DrainBatch();
+
+      if (stopping) {
+        return;
+      }
+    }
+  }
+
+  void DrainBatch() {
+    // Only drain what fits in one pass of the ring so that a producer logging faster than we can write
+    // doesn't keep this thread from checking for shutdown
+    for (size_t i = 0; i < m_Ring.GetCapacity(); i++) {
+      if (!m_Ring.TryPop([this](LogRecord& record) { m_Handler(record); })) {
+        return;
+      }
+    }
+  }
+
+  MpscRing<LogRecord> m_Ring;
+  RingOverflowPolicy m_Policy;
+  RecordHandler m_Handler;
+  std::atomic<uint64_t> m_DroppedRecords{0};
+
+  std::mutex m_WakeMutex;
+  std::condition_variable m_Wake;
+  bool m_Stop = false;
+
+  // Declared last so the thread starts after everything it uses has been constructed
+  std::thread m_Thread;
+};
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * A small LZ77 compressor for closed log segments, in the LZ4 block format. .wpilog files repeat the same record
+ * headers, entry ids and slowly changing values over and over, so even a fast greedy matcher roughly halves them,
+ * and decompressing is a handful of copies per record.
+ *
+ * A compressed file is the magic "BLZ1" followed by blocks of up to kBlockSize input bytes, each stored as its
+ * input size, its stored size and its data, both sizes as 4 byte little endian integers. A block that doesn't shrink
+ * is stored as is, which shows up as the two sizes being equal. Blocks are compressed independently, so compressing
+ * a file of any size only ever holds one block in memory.
+ */
+class BlockCodec {
+public:
+  static constexpr size_t kBlockSize = 1 << 20;
+  static constexpr uint8_t kMagic[] = {'B', 'L', 'Z', '1'};
+
+  BlockCodec() : m_Table(size_t{1} << kHashBits) {}
+
+  static bool IsCompressed(std::span<const uint8_t> data) {
+    return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+  }
+
+  /**
+   * Compress the file at fromPath into toPath, replacing it. Returns false if either file can't be used.
+   */
+  bool CompressFile(const std::string& fromPath, const std::string& toPath) {
+    std::ifstream in(fromPath, std::ios::binary);
+    std::ofstream out(toPath, std::ios::binary | std::ios::trunc);
+    if (!in || !out) {
+      return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(kMagic), sizeof(kMagic));
+
+    m_Input.resize(kBlockSize);
+    while (in) {
+      in.read(reinterpret_cast<char*>(m_Input.data()), kBlockSize);
+      auto size = static_cast<size_t>(in.gcount());
+      if (size == 0) {
+        break;
+      }
+
+      std::span<const uint8_t> block(m_Input.data(), size);
+      m_Output.clear();
+      CompressBlock(block, m_Output);
+      if (m_Output.size() >= size) {
+        m_Output.assign(block.begin(), block.end());
+      }
+
+      uint8_t sizes[8];
+      WriteInteger(sizes, static_cast<uint32_t>(size));
+      WriteInteger(sizes + 4, static_cast<uint32_t>(m_Output.size()));
+      out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+      out.write(reinterpret_cast<const char*>(m_Output.data()), static_cast<std::streamsize>(m_Output.size()));
+    }
+
+    return !in.bad() && static_cast<bool>(out);
+  }
+
+  /**
+   * Decompress a whole compressed file into out. Returns false if the data is corrupt or cut off.
+   */
+  static bool Decompress(std::span<const uint8_t> in, std::vector<uint8_t>& out) {
+    if (!IsCompressed(in)) {
+      return false;
+    }
+
+    out.clear();
+    size_t position = sizeof(kMagic);
+    while (position < in.size()) {
+      if (in.size() - position < 8) {
+        return false;
+      }
+      uint32_t size = ReadInteger(in.data() + position);
+      uint32_t storedSize = ReadInteger(in.data() + position + 4);
+      position += 8;
+      if (size > kBlockSize || storedSize > size || in.size() - position < storedSize) {
+        return false;
+      }
+
+      std::span<const uint8_t> stored = in.subspan(position, storedSize);
+      size_t offset = out.size();
+      out.resize(offset + size);
+      std::span<uint8_t> block(out.data() + offset, size);
+
+      if (storedSize == size) {
+        std::memcpy(block.data(), stored.data(), size);
+      } else if (!DecompressBlock(stored, block)) {
+        return false;
+      }
+      position += storedSize;
+    }
+    return true;
+  }
+
+  /**
+   * Append the compressed form of one block to out.
+   */
+  void CompressBlock(std::span<const uint8_t> in, std::vector<uint8_t>& out) {
+    const uint8_t* data = in.data();
+    size_t size = in.size();
+    size_t anchor = 0;
+
+    // The format ends every block with at least 5 literals, and a match can't start in the last 12 bytes
+    if (size > kMinInputToMatch) {
+      std::fill(m_Table.begin(), m_Table.end(), 0);
+      size_t matchLimit = size - kLastLiterals;
+      size_t position = 0;
+      size_t misses = 0;
+
+      while (position < size - kMinInputToMatch) {
+        uint32_t sequence = Read32(data + position);
+        uint32_t& slot = m_Table[Hash(sequence)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(position);
+
+        if (candidate >= position || position - candidate > kMaxOffset || Read32(data + candidate) != sequence) {
+          // Skip ahead faster through data that doesn't compress
+          position += 1 + (misses++ >> 6);
+          continue;
+        }
+        misses = 0;
+
+        size_t length = kMinMatch;
+        while (position + length < matchLimit && data[candidate + length] == data[position + length]) {
+          length++;
+        }
+
+        WriteSequence(out, in.subspan(anchor, position - anchor), position - candidate, length);
+        position += length;
+        anchor = position;
+      }
+    }
+
+    WriteLiterals(out, in.subspan(anchor));
+  }
+
+  /**
+   * Decompress one block into out, which must be exactly the block's decompressed size.
+   */
+  static bool DecompressBlock(std::span<const uint8_t> in, std::span<uint8_t> out) {
+    size_t input = 0;
+    size_t output = 0;
+
+    while (input < in.size()) {
+      uint8_t token = in[input++];
+
+      size_t literals = token >> 4;
+      if (!ReadLength(in, input, literals) || in.size() - input < literals || out.size() - output < literals) {
+        return false;
+      }
+      std::memcpy(out.data() + output, in.data() + input, literals);
+      input += literals;
+      output += literals;
+
+      // The last sequence is only literals
+      if (input == in.size()) {
+        break;
+      }
+
+      if (in.size() - input < 2) {
+        return false;
+      }
+      size_t offset = in[input] | (in[input + 1] << 8);
+      input += 2;
+
+      size_t length = token & 0xf;
+      if (offset == 0 || offset > output || !ReadLength(in, input, length)) {
+        return false;
+      }
+      length += kMinMatch;
+      if (out.size() - output < length) {
+        return false;
+      }
+
+      // Byte by byte, since a match can overlap the bytes it is copying
+      for (size_t i = 0; i < length; i++) {
+        out[output + i] = out[output - offset + i];
+      }
+      output += length;
+    }
+    return output == out.size();
+  }
+
+private:
+  static constexpr int kHashBits = 16;
+  static constexpr size_t kMinMatch = 4;
+  static constexpr size_t kMaxOffset = 65535;
+  static constexpr size_t kLastLiterals = 5;
+  static constexpr size_t kMinInputToMatch = 12;
+
+  static uint32_t Hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - kHashBits);
+  }
+
+  // The input isn't aligned, so copy out rather than casting the pointer
+  static uint32_t Read32(const uint8_t* bytes) {
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+
+  static uint32_t ReadInteger(const uint8_t* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+
+  static void WriteInteger(uint8_t* bytes, uint32_t value) {
+    for (size_t i = 0; i < 4; i++) {
+      bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+  }
+
+  // A length that didn't fit in its 4 bits of the token continues in bytes of 255, ended by a smaller byte
+  static bool ReadLength(std::span<const uint8_t> in, size_t& input, size_t& length) {
+    if (length != 0xf) {
+      return true;
+    }
+    uint8_t byte;
+    do {
+      if (input == in.size()) {
+        return false;
+      }
+      byte = in[input++];
+      length += byte;
+    } while (byte == 255);
+    return true;
+  }
+
+  static void WriteLength(std::vector<uint8_t>& out, size_t length) {
+    for (length -= 0xf; length >= 255; length -= 255) {
+      out.push_back(255);
+    }
+    out.push_back(static_cast<uint8_t>(length));
+  }
+
+  static void WriteSequence(std::vector<uint8_t>& out, std::span<const uint8_t> literals, size_t offset,
+                            size_t length) {
+    size_t matchLength = length - kMinMatch;
+    out.push_back(static_cast<uint8_t>((std::min<size_t>(literals.size(), 0xf) << 4) |
+                                       std::min<size_t>(matchLength, 0xf)));
+    if (literals.size() >= 0xf) {
+      WriteLength(out, literals.size());
+    }
+    out.insert(out.end(), literals.begin(), literals.end());
+
+    out.push_back(static_cast<uint8_t>(offset));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (matchLength >= 0xf) {
+      WriteLength(out, matchLength);
+    }
+  }
+
+  static void WriteLiterals(std::vector<uint8_t>& out, std::span<const uint8_t> literals) {
+    out.push_back(static_cast<uint8_t>(std::min<size_t>(literals.size(), 0xf) << 4));
+    if (literals.size() >= 0xf) {
+      WriteLength(out, literals.size());
+    }
+    out.insert(out.end(), literals.begin(), literals.end());
+  }
+
+  std::vector<uint32_t> m_Table;
+  std::vector<uint8_t> m_Input;
+  std::vector<uint8_t> m_Output;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <units/time.h>
+
+#include "bearlog/internal/log_type_traits.h"
+
+/**
+ * Settings for skipping values that haven't changed since the last one written for a key.
+ *
+ * Doubles and double arrays count as unchanged when every element is within the deadband of the last written
+ * value. The deadband is the larger of the absolute deadband and the relative deadband times the size of the last
+ * value. All other types only count as unchanged when they are exactly equal.
+ *
+ * Even an unchanged value is written once the keyframe period has passed since the last write, so viewers that
+ * join late or scrub through the log still see the current value.
+ */
+struct ChangeFilter {
+  bool skipUnchanged = false;
+  double absoluteDeadband = 0.0;
+  double relativeDeadband = 0.0;
+  units::second_t keyframePeriod = 1_s;
+
+  static ChangeFilter Off() {
+    return ChangeFilter{};
+  }
+
+  static ChangeFilter SkipUnchanged(units::second_t keyframePeriod = 1_s) {
+    return ChangeFilter{true, 0.0, 0.0, keyframePeriod};
+  }
+
+  static ChangeFilter AbsoluteDeadband(double deadband, units::second_t keyframePeriod = 1_s) {
+    return ChangeFilter{true, deadband, 0.0, keyframePeriod};
+  }
+
+  static ChangeFilter RelativeDeadband(double fraction, units::second_t keyframePeriod = 1_s) {
+    return ChangeFilter{true, 0.0, fraction, keyframePeriod};
+  }
+};
+
+/**
+ * Per key state for a ChangeFilter: the last value that was written and when. Only allocated for keys that have
+ * filtering turned on, so unfiltered keys don't pay for the cached value.
+ */
+class ChangeFilterState {
+public:
+  explicit ChangeFilterState(const ChangeFilter& filter)
+      : m_AbsoluteDeadband(filter.absoluteDeadband),
+        m_RelativeDeadband(filter.relativeDeadband),
+        m_KeyframePeriodMicros(static_cast<uint64_t>(filter.keyframePeriod.value() * 1e6)) {
+  }
+
+  /**
+   * Returns true if the value should be written. When it returns true the value is remembered as the last
+   * written value.
+   */
+  template<typename T>
+  bool ShouldWrite(typename LogTypeTraits<T>::ValueParam value, uint64_t timestamp) {
+    // Values for one key can come from more than one thread
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+
+    bool keyframeDue = !m_HasValue || (timestamp - m_LastWriteTimestamp) >= m_KeyframePeriodMicros;
+    if (!keyframeDue && IsUnchanged<T>(value)) {
+      return false;
+    }
+
+    Remember<T>(value);
+    m_HasValue = true;
+    m_LastWriteTimestamp = timestamp;
+    return true;
+  }
+
+private:
+  bool WithinDeadband(double value, double last) const {
+    double deadband = std::max(m_AbsoluteDeadband, m_RelativeDeadband * std::abs(last));
+    return std::abs(value - last) <= deadband;
+  }
+
+  template<typename Element>
+  bool ArrayWithinDeadband(std::span<const Element> value, const std::vector<Element>& last) const {
+    if (value.size() != last.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < value.size(); i++) {
+      if (!WithinDeadband(value[i], last[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template<typename T>
+  bool IsUnchanged(typename LogTypeTraits<T>::ValueParam value) const {
+    constexpr LogType kType = LogTypeTraits<T>::kType;
+
+    if constexpr (kType == LogType::Boolean) {
+      return value == m_LastBoolean;
+    } else if constexpr (kType == LogType::Double) {
+      return WithinDeadband(value, m_LastDouble);
+    } else if constexpr (kType == LogType::Integer) {
+      return value == m_LastInteger;
+    } else if constexpr (kType == LogType::String) {
+      return value == m_LastString;
+    } else if constexpr (kType == LogType::DoubleArray) {
+      return ArrayWithinDeadband(value, m_LastDoubleArray);
+    } else if constexpr (kType == LogType::FloatArray) {
+      return ArrayWithinDeadband(value, m_LastFloatArray);
+    } else if constexpr (kType == LogType::IntegerArray) {
+      return std::equal(value.begin(), value.end(), m_LastIntegerArray.begin(), m_LastIntegerArray.end());
+    } else if constexpr (kType == LogType::BooleanArray) {
+      return std::equal(value.begin(), value.end(), m_LastBooleanArray.begin(), m_LastBooleanArray.end());
+    } else if constexpr (kType == LogType::Struct) {
+      return std::equal(value.data.begin(), value.data.end(), m_LastStruct.begin(), m_LastStruct.end());
+    } else {
+      return std::equal(value.begin(), value.end(), m_LastStringArray.begin(), m_LastStringArray.end());
+    }
+  }
+
+  template<typename T>
+  void Remember(typename LogTypeTraits<T>::ValueParam value) {
+    constexpr LogType kType = LogTypeTraits<T>::kType;
+
+    if constexpr (kType == LogType::Boolean) {
+      m_LastBoolean = value;
+    } else if constexpr (kType == LogType::Double) {
+      m_LastDouble = value;
+    } else if constexpr (kType == LogType::Integer) {
+      m_LastInteger = value;
+    } else if constexpr (kType == LogType::String) {
+      m_LastString.assign(value);
+    } else if constexpr (kType == LogType::DoubleArray) {
+      m_LastDoubleArray.assign(value.begin(), value.end());
+    } else if constexpr (kType == LogType::FloatArray) {
+      m_LastFloatArray.assign(value.begin(), value.end());
+    } else if constexpr (kType == LogType::IntegerArray) {
+      m_LastIntegerArray.assign(value.begin(), value.end());
+    } else if constexpr (kType == LogType::BooleanArray) {
+      m_LastBooleanArray.assign(value.begin(), value.end());
+    } else if constexpr (kType == LogType::Struct) {
+      m_LastStruct.assign(value.data.begin(), value.data.end());
+    } else {
+      m_LastStringArray.assign(value.begin(), value.end());
+    }
+  }
+
+  const double m_AbsoluteDeadband;
+  const double m_RelativeDeadband;
+  const uint64_t m_KeyframePeriodMicros;
+
+  std::mutex m_Mutex;
+  bool m_HasValue = false;
+  uint64_t m_LastWriteTimestamp = 0;
+
+  // Only the member matching the key's type is used
+  bool m_LastBoolean = false;
+  double m_LastDouble = 0.0;
+  int64_t m_LastInteger = 0;
+  std::string m_LastString;
+  std::vector<double> m_LastDoubleArray;
+  std::vector<std::string> m_LastStringArray;
+  std::vector<float> m_LastFloatArray;
+  std::vector<int64_t> m_LastIntegerArray;
+  std::vector<bool> m_LastBooleanArray;
+  // Structs are compared by their packed bytes, so deadbands don't apply to them
+  std::vector<uint8_t> m_LastStruct;
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Maps keys to values, safe to use from any number of threads. Looking up an existing key never takes a lock; only
+ * adding one does. Keys are never removed, and old tables are kept after growing since readers may still be probing
+ * them, so every returned reference stays valid as long as the registry does.
+ */
+template<typename Value>
+class ConcurrentKeyRegistry {
+public:
+  ConcurrentKeyRegistry() {
+    m_Tables.push_back(std::make_unique<Table>(kInitialBucketCount));
+    m_Table.store(m_Tables.back().get(), std::memory_order_release);
+  }
+
+  ConcurrentKeyRegistry(const ConcurrentKeyRegistry&) = delete;
+  ConcurrentKeyRegistry& operator=(const ConcurrentKeyRegistry&) = delete;
+
+  /**
+   * Lock-free lookup. Returns nullptr if the key has not been added yet.
+   */
+  Value* Find(std::string_view key) {
+    return Find(key, std::hash<std::string_view>{}(key));
+  }
+
+  /**
+   * Look up a key, calling create() to make its value the first time the key is seen. create() runs with the lock
+   * held, so it is only called once per key. It may take the stored key, which lives as long as the registry.
+   */
+  template<typename Create>
+  Value& GetOrCreate(std::string_view key, Create&& create) {
+    size_t hash = std::hash<std::string_view>{}(key);
+    if (Value* value = Find(key, hash)) {
+      return *value;
+    }
+
+    const std::lock_guard<std::mutex> lock(m_InsertMutex);
+
+    // Another thread may have added the key while we were waiting for the lock
+    if (Value* value = Find(key, hash)) {
+      return *value;
+    }
+
+    Node& node = m_Nodes.emplace_back(std::string(key), hash, std::forward<Create>(create));
+
+    Table* table = m_Table.load(std::memory_order_relaxed);
+    if ((m_Nodes.size() * 2) > table->size) {
+      table = Grow(table);
+    }
+    Insert(*table, &node);
+
+    return node.value;
+  }
+
+  size_t Size() {
+    const std::lock_guard<std::mutex> lock(m_InsertMutex);
+    return m_Nodes.size();
+  }
+
+  /**
+   * Size the table up front so that adding up to count keys in total never has to rebuild it.
+   */
+  void Reserve(size_t count) {
+    const std::lock_guard<std::mutex> lock(m_InsertMutex);
+
+    Table* table = m_Table.load(std::memory_order_relaxed);
+    size_t bucketCount = table->size;
+    while ((count * 2) > bucketCount) {
+      bucketCount *= 2;
+    }
+
+    if (bucketCount > table->size) {
+      Rebuild(bucketCount, m_Nodes.size());
+    }
+  }
+
+  /**
+   * Call visit(key, value) for every key added so far, in the order they were added. Holds the insertion lock, so
+   * visit() must not add keys.
+   */
+  template<typename Visit>
+  void ForEach(Visit&& visit) {
+    const std::lock_guard<std::mutex> lock(m_InsertMutex);
+
+    for (Node& node : m_Nodes) {
+      visit(std::string_view(node.key), node.value);
+    }
+  }
+
+private:
+  static constexpr size_t kInitialBucketCount = 64;
+
+  struct Node {
+    // The value is built directly from create()'s result so that values don't need to be copyable or movable
+    template<typename Create>
+    Node(std::string nodeKey, size_t nodeHash, Create&& create)
+        : key(std::move(nodeKey)), hash(nodeHash), value(CreateValue(create, key)) {}
+
+    template<typename Create>
+    static Value CreateValue(Create& create, std::string_view storedKey) {
+      if constexpr (std::is_invocable_v<Create&, std::string_view>) {
+        return create(storedKey);
+      } else {
+        return create();
+      }
+    }
+
+    const std::string key;
+    const size_t hash;
+    Value value;
+  };
+
+  struct Table {
+    explicit Table(size_t bucketCount)
+        : size(bucketCount), buckets(std::make_unique<std::atomic<Node*>[]>(bucketCount)) {}
+
+    const size_t size;
+    std::unique_ptr<std::atomic<Node*>[]> buckets;
+  };
+
+  Value* Find(std::string_view key, size_t hash) {
+    Table* table = m_Table.load(std::memory_order_acquire);
+    size_t mask = table->size - 1;
+
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+      Node* node = table->buckets[i].load(std::memory_order_acquire);
+      if (!node) {
+        return nullptr;
+      }
+      if (node->hash == hash && node->key == key) {
+        return &node->value;
+      }
+    }
+  }
+
+  // Must be called with m_InsertMutex held
+  static void Insert(Table& table, Node* node) {
+    size_t mask = table.size - 1;
+    size_t i = node->hash & mask;
+    while (table.buckets[i].load(std::memory_order_relaxed)) {
+      i = (i + 1) & mask;
+    }
+    table.buckets[i].store(node, std::memory_order_release);
+  }
+
+  // Must be called with m_InsertMutex held
+  Table* Grow(Table* oldTable) {
+    // Every node except the one being added is already in the old table, so rebuild from the node list.
+    // The newest node is inserted by the caller.
+    return Rebuild(oldTable->size * 2, m_Nodes.size() - 1);
+  }
+
+  // Build a new table holding the first nodeCount nodes and swap it in. Must be called with m_InsertMutex held.
+  Table* Rebuild(size_t bucketCount, size_t nodeCount) {
+    m_Tables.push_back(std::make_unique<Table>(bucketCount));
+    Table* newTable = m_Tables.back().get();
+
+    for (size_t i = 0; i < nodeCount; i++) {
+      Insert(*newTable, &m_Nodes[i]);
+    }
+
+    m_Table.store(newTable, std::memory_order_release);
+    return newTable;
+  }
+
+  std::atomic<Table*> m_Table;
+
+  std::mutex m_InsertMutex;
+  // std::deque never moves existing elements when growing at the end, so node addresses are stable
+  std::deque<Node> m_Nodes;
+  std::vector<std::unique_ptr<Table>> m_Tables;
+};
@@ -1,107 +1,82 @@
 #pragma once
 
+#include <atomic>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include "frc/DataLogManager.h"
 #include "wpi/DataLog.h"
 
+#include "bearlog/internal/log_type_traits.h"
+
 class DataLogWriter {
 public:
   DataLogWriter(const std::string& logTable):
-        m_LogTable(logTable), m_Log(frc::DataLogManager::GetLog()) {
+        m_KeyPrefix(logTable + "/"), m_NTKeyPrefix("NT/" + logTable + "/") {
   }
 
-  void Log(uint64_t timestamp, std::string key, bool value) {
-    if (m_BooleanLogs.contains(key)) {
-      m_BooleanLogs.at(key).Append(value);
-    } else {
-      auto new_boolean_log = wpi::log::BooleanLogEntry(m_Log, GetPrefixKey(key), kEntryMetadata, timestamp);
-
-      new_boolean_log.Append(value);
-      m_BooleanLogs[key] = std::move(new_boolean_log);
-    }
+  /**
+   * Write to this log instead of DataLogManager's. Returns false if a log is already being written, since entries
+   * can't move between logs.
+   */
+  bool SetLog(wpi::log::DataLog& log) {
+    wpi::log::DataLog* expected = nullptr;
+    return m_Log.compare_exchange_strong(expected, &log, std::memory_order_acq_rel);
   }
 
-  void Log(uint64_t timestamp, std::string key, std::span<const double> value) {
-    if (m_DoubleArrayLogs.contains(key)) {
-      m_DoubleArrayLogs.at(key).Append(value);
-    } else {
-      auto new_double_array_log = wpi::log::DoubleArrayLogEntry(m_Log, GetPrefixKey(key), kEntryMetadata, timestamp);
-
-      new_double_array_log.Append(value);
-      m_DoubleArrayLogs[key] = std::move(new_double_array_log);
+  /**
+   * Start a new entry in the log for a key and return its entry ID. Struct entries also get their schema added to
+   * the log so that AdvantageScope can decode them.
+   */
+  int StartEntry(uint64_t timestamp, std::string_view key, LogType type, const StructTypeInfo* structInfo) {
+    wpi::log::DataLog& log = GetLog();
+    if (structInfo) {
+      structInfo->addDataLogSchema(log, timestamp);
+      return log.Start(GetPrefixKey(key), structInfo->typeString, kEntryMetadata, timestamp);
     }
+    return log.Start(GetPrefixKey(key), GetDataLogTypeString(type), kEntryMetadata, timestamp);
   }
 
-  void Log(uint64_t timestamp, std::string key, double value) {
-    if (m_DoubleLogs.contains(key)) {
-      m_DoubleLogs.at(key).Append(value);
-    } else {
-      auto new_double_log = wpi::log::DoubleLogEntry(m_Log, GetPrefixKey(key), kEntryMetadata, timestamp);
-
-      new_double_log.Append(value);
-      m_DoubleLogs[key] = std::move(new_double_log);
-    }
+  void FinishEntry(int entry, uint64_t timestamp) {
+    m_Log.load(std::memory_order_acquire)->Finish(entry, timestamp);
   }
 
-  void Log(uint64_t timestamp, std::string key, int value) {
-    if (m_IntegerLogs.contains(key)) {
-      m_IntegerLogs.at(key).Append(value);
-    } else {
-      auto new_integer_log = wpi::log::IntegerLogEntry(m_Log, GetPrefixKey(key), kEntryMetadata, timestamp);
-
-      new_integer_log.Append(value);
-      m_IntegerLogs[key] = std::move(new_integer_log);
-    }
-  }
-
-  void Log(uint64_t timestamp, std::string key, std::span<const std::string> value) {
-    if (m_StringArrayLogs.contains(key)) {
-      m_StringArrayLogs.at(key).Append(value);
-    } else {
-      auto new_string_array_log = wpi::log::StringArrayLogEntry(m_Log, GetPrefixKey(key), kEntryMetadata, timestamp);
-
-      new_string_array_log.Append(value);
-      m_StringArrayLogs[key] = std::move(new_string_array_log);
-    }
-  }
-
-  void Log(uint64_t timestamp, std::string key, const std::string& value) {
-    if (m_StringLogs.contains(key)) {
-      m_StringLogs.at(key).Append(value);
-    } else {
-      auto new_string_log = wpi::log::StringLogEntry(m_Log, GetPrefixKey(key), kEntryMetadata, timestamp);
-
-      new_string_log.Append(value);
-      m_StringLogs[key] = std::move(new_string_log);
-    }
+  template<typename T>
+  void Append(int entry, typename LogTypeTraits<T>::ValueParam value, uint64_t timestamp) {
+    LogTypeTraits<T>::Append(*m_Log.load(std::memory_order_acquire), entry, value, timestamp);
   }
 
   void SetShouldUseNTTablePrefix(bool useNTTablePrefix) {
     // Use the NT/ prefix when logging to file so that when viewing .wpilog data in AdvantageScope,
     // the values can be re-used as when they are being viewed live on NetworkTables.
-    if (useNTTablePrefix) {
-      m_TablePrefix = "NT/";
-    } else {
-      m_TablePrefix = "";
-    }
+    m_UseNTTablePrefix.store(useNTTablePrefix, std::memory_order_relaxed);
   }
 
-  std::string GetPrefixKey(std::string key) {
-    return m_TablePrefix + m_LogTable + "/" + key;
+  std::string GetPrefixKey(std::string_view key) const {
+    const std::string& keyPrefix = m_UseNTTablePrefix.load(std::memory_order_relaxed) ? m_NTKeyPrefix : m_KeyPrefix;
+    std::string prefixKey;
+    prefixKey.reserve(keyPrefix.size() + key.size());
+    prefixKey += keyPrefix;
+    prefixKey += key;
+    return prefixKey;
   }
 
 private:
-  const std::string kEntryMetadata = "{\"source\":\"BearLog\"}";
+  // Falls back to DataLogManager's log when the first entry starts, so SetLog() still works until then. Values are
+  // only appended to entries that have started, so the log is always set by then.
+  wpi::log::DataLog& GetLog() {
+    wpi::log::DataLog* log = m_Log.load(std::memory_order_acquire);
+    if (!log) {
+      SetLog(frc::DataLogManager::GetLog());
+      log = m_Log.load(std::memory_order_acquire);
+    }
+    return *log;
+  }
 
-  std::string m_LogTable;
-  wpi::log::DataLog& m_Log;
-  std::string m_TablePrefix;
+  const std::string kEntryMetadata = "{\"source\":\"BearLog\"}";
 
-  std::unordered_map<std::string, wpi::log::BooleanLogEntry> m_BooleanLogs;
-  std::unordered_map<std::string, wpi::log::DoubleArrayLogEntry> m_DoubleArrayLogs;
-  std::unordered_map<std::string, wpi::log::DoubleLogEntry> m_DoubleLogs;
-  std::unordered_map<std::string, wpi::log::IntegerLogEntry> m_IntegerLogs;
-  std::unordered_map<std::string, wpi::log::StringArrayLogEntry> m_StringArrayLogs;
-  std::unordered_map<std::string, wpi::log::StringLogEntry> m_StringLogs;
+  std::atomic<wpi::log::DataLog*> m_Log{nullptr};
+  // Built once instead of for every new key. Keys can start at the same time as the prefix is switched.
+  const std::string m_KeyPrefix;
+  const std::string m_NTKeyPrefix;
+  std::atomic<bool> m_UseNTTablePrefix{false};
 };
\ No newline at end of file
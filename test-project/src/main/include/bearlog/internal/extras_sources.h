@@ -0,0 +1,167 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <frc/Notifier.h>
+#include <frc/PowerDistribution.h>
+#include <frc/RobotController.h>
+#include <units/frequency.h>
+#include <units/time.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Runs one source of extras on its own Notifier thread at its own rate, so a slow source, like a CAN read that
+ * times out, can't hold up the others.
+ */
+class ExtrasSampler {
+public:
+  ExtrasSampler(std::string_view name, std::function<void()> sample) : m_Notifier(std::move(sample)) {
+    m_Notifier.SetName(name);
+  }
+
+  // A rate of 0 turns the source off
+  void Start(units::hertz_t rate) {
+    if (rate.value() > 0) {
+      m_Notifier.StartPeriodic(units::second_t{1.0 / rate.value()});
+    } else {
+      m_Notifier.Stop();
+    }
+  }
+
+  void Stop() {
+    m_Notifier.Stop();
+  }
+
+private:
+  frc::Notifier m_Notifier;
+};
+
+/**
+ * Everything read from the power distribution module in one sample.
+ */
+struct PdhSnapshot {
+  double temperature = 0.0;
+  double voltage = 0.0;
+  std::vector<double> channelCurrents;
+  double totalCurrent = 0.0;
+  double totalPower = 0.0;
+  double totalEnergy = 0.0;
+  int channelCount = 0;
+
+  void Read(const frc::PowerDistribution& pdh) {
+    temperature = pdh.GetTemperature();
+    voltage = pdh.GetVoltage();
+    // Read all of the channels at once rather than one at a time
+    channelCurrents = pdh.GetAllCurrents();
+    totalCurrent = pdh.GetTotalCurrent();
+    totalPower = pdh.GetTotalPower();
+    totalEnergy = pdh.GetTotalEnergy();
+    channelCount = pdh.GetNumChannels();
+  }
+};
+
+/**
+ * Battery, brownout and CAN bus state from the roboRIO.
+ */
+struct RobotControllerSnapshot {
+  double batteryVoltage = 0.0;
+  bool brownedOut = false;
+  frc::CANStatus canStatus{};
+
+  void Read() {
+    batteryVoltage = frc::RobotController::GetBatteryVoltage().value();
+    brownedOut = frc::RobotController::IsBrownedOut();
+    canStatus = frc::RobotController::GetCANStatus();
+  }
+};
+
+/**
+ * CPU and memory use of the robot program, read from /proc/self/stat. Only available on Linux, which covers the
+ * roboRIO and Linux simulation.
+ */
+class ProcessSnapshot {
+public:
+  double cpuPercent = 0.0;
+  double residentMegabytes = 0.0;
+  int64_t threadCount = 0;
+
+  /**
+   * Returns false if the stats couldn't be read. CPU use is averaged over the time since the last read, so the
+   * first read always reports 0.
+   */
+  bool Read() {
+#ifdef __linux__
+    // Read into a fixed buffer so sampling doesn't allocate
+    char buffer[1024];
+    int file = ::open("/proc/self/stat", O_RDONLY);
+    if (file < 0) {
+      return false;
+    }
+    ssize_t length = ::read(file, buffer, sizeof(buffer) - 1);
+    ::close(file);
+    if (length <= 0) {
+      return false;
+    }
+    buffer[length] = '\0';
+
+    // The program name in field 2 can contain spaces, so start counting fields after its closing parenthesis
+    std::string_view stat(buffer, static_cast<size_t>(length));
+    size_t nameEnd = stat.rfind(')');
+    if (nameEnd == std::string_view::npos) {
+      return false;
+    }
+
+    // Skip the process state in field 3, which is a letter, then read fields 4 to 24 of proc(5)
+    char* position = buffer + nameEnd + 1;
+    while (*position == ' ') {
+      position++;
+    }
+    while (*position != ' ' && *position != '\0') {
+      position++;
+    }
+
+    uint64_t fields[21] = {};
+    for (uint64_t& field : fields) {
+      field = std::strtoull(position, &position, 10);
+    }
+
+    // User time plus system time, fields 14 and 15
+    uint64_t cpuTicks = fields[10] + fields[11];
+    auto now = std::chrono::steady_clock::now();
+    if (m_HasLastRead) {
+      double elapsedSeconds = std::chrono::duration<double>(now - m_LastReadTime).count();
+      double cpuSeconds = static_cast<double>(cpuTicks - m_LastCpuTicks) / kTicksPerSecond;
+      cpuPercent = elapsedSeconds > 0.0 ? 100.0 * cpuSeconds / elapsedSeconds : 0.0;
+    }
+    m_HasLastRead = true;
+    m_LastCpuTicks = cpuTicks;
+    m_LastReadTime = now;
+
+    threadCount = static_cast<int64_t>(fields[16]);
+    residentMegabytes = static_cast<double>(fields[20]) * kPageSize / (1024.0 * 1024.0);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+private:
+#ifdef __linux__
+  inline static const double kTicksPerSecond = static_cast<double>(::sysconf(_SC_CLK_TCK));
+  inline static const double kPageSize = static_cast<double>(::sysconf(_SC_PAGESIZE));
+#endif
+
+  bool m_HasLastRead = false;
+  uint64_t m_LastCpuTicks = 0;
+  std::chrono::steady_clock::time_point m_LastReadTime;
+};
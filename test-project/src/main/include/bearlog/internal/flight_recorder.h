@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <units/frequency.h>
+#include <units/time.h>
+
+#include "bearlog/internal/log_type_traits.h"
+
+/**
+ * Keep recent values for every key that starts with the prefix in memory instead of writing them to the log file.
+ * Each key holds up to duration * rate values, which are only written out when a trigger fires. An empty prefix
+ * matches every key.
+ */
+struct FlightRecorder {
+  std::string prefix;
+  units::second_t duration;
+  units::hertz_t rate;
+
+  size_t GetCapacity() const {
+    return std::max<size_t>(1, static_cast<size_t>(std::ceil(duration.value() * rate.value())));
+  }
+};
+
+/**
+ * Per key ring of the most recent values for a FlightRecorder. The ring is allocated at its full size when the
+ * key is registered, and recording or dumping it never allocates. Once full, each new value replaces the oldest.
+ *
+ * Only booleans, doubles and integers are recorded, stored as their raw 64 bits. Keys of other types are written
+ * to the log file as usual.
+ */
+class FlightRecorderRing {
+public:
+  static constexpr bool IsSupported(LogType type) {
+    return type == LogType::Boolean || type == LogType::Double || type == LogType::Integer;
+  }
+
+  explicit FlightRecorderRing(size_t capacity) : m_Samples(capacity) {}
+
+  size_t GetCapacity() const {
+    return m_Samples.size();
+  }
+
+  template<typename T>
+  void Record(typename LogTypeTraits<T>::ValueParam value, uint64_t timestamp) {
+    // Values for one key can come from more than one thread
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Samples[m_Next] = Sample{timestamp, ToBits<T>(value)};
+    m_Next = (m_Next + 1) % m_Samples.size();
+    m_Size = std::min(m_Size + 1, m_Samples.size());
+  }
+
+  /**
+   * Call write(value, timestamp) for every recorded value, oldest first, then empty the ring so the next dump
+   * doesn't repeat them.
+   */
+  template<typename T, typename Write>
+  void Drain(Write&& write) {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+
+    size_t oldest = (m_Next + m_Samples.size() - m_Size) % m_Samples.size();
+    for (size_t i = 0; i < m_Size; i++) {
+      const Sample& sample = m_Samples[(oldest + i) % m_Samples.size()];
+      write(FromBits<T>(sample.bits), sample.timestamp);
+    }
+    m_Size = 0;
+  }
+
+private:
+  struct Sample {
+    uint64_t timestamp = 0;
+    uint64_t bits = 0;
+  };
+
+  template<typename T>
+  static uint64_t ToBits(typename LogTypeTraits<T>::ValueParam value) {
+    if constexpr (LogTypeTraits<T>::kType == LogType::Double) {
+      return std::bit_cast<uint64_t>(value);
+    } else {
+      return static_cast<uint64_t>(value);
+    }
+  }
+
+  template<typename T>
+  static typename LogTypeTraits<T>::ValueParam FromBits(uint64_t bits) {
+    if constexpr (LogTypeTraits<T>::kType == LogType::Double) {
+      return std::bit_cast<double>(bits);
+    } else if constexpr (LogTypeTraits<T>::kType == LogType::Boolean) {
+      return bits != 0;
+    } else {
+      return static_cast<int64_t>(bits);
+    }
+  }
+
+  std::mutex m_Mutex;
+  std::vector<Sample> m_Samples;
+  size_t m_Next = 0;
+  size_t m_Size = 0;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Include and exclude rules for keys, compiled into a prefix trie.
+ *
+ * Each rule is a key prefix with a leading '+' to include or '-' to exclude. A trailing '*' is allowed and
+ * ignored, so "-Vision/" and "-Vision/" followed by '*' mean the same thing:
+ *
+ *   -Debug/
+ *   +Debug/Elevator/
+ *   -Vision/
+ *
+ * The rule with the longest prefix that matches a key decides whether it is logged, so more specific rules
+ * override broader ones. Keys that no rule matches are logged. Blank lines and lines starting with '#' are
+ * ignored, and a rule without a leading '+' or '-' is an include rule.
+ */
+class KeyFilter {
+public:
+  KeyFilter() : m_Nodes(1) {}
+
+  explicit KeyFilter(std::span<const std::string> rules) : m_Nodes(1) {
+    for (const std::string& rule : rules) {
+      AddRule(rule);
+    }
+  }
+
+  bool IsEnabled(std::string_view key) const {
+    // Walk the trie one character at a time, keeping the decision of the deepest rule passed so far
+    uint32_t node = 0;
+    bool enabled = m_Nodes[0].decision != Decision::Exclude;
+
+    for (char c : key) {
+      node = FindChild(node, c);
+      if (node == kNoNode) {
+        break;
+      }
+      if (m_Nodes[node].decision != Decision::None) {
+        enabled = m_Nodes[node].decision == Decision::Include;
+      }
+    }
+    return enabled;
+  }
+
+  bool IsEmpty() const {
+    return m_Nodes.size() == 1 && m_Nodes[0].decision == Decision::None;
+  }
+
+private:
+  enum class Decision : uint8_t {None, Include, Exclude};
+
+  static constexpr uint32_t kNoNode = UINT32_MAX;
+
+  struct Node {
+    Decision decision = Decision::None;
+    std::vector<std::pair<char, uint32_t>> children;
+  };
+
+  void AddRule(std::string_view rule) {
+    // Trim surrounding whitespace, including the '\r' from files saved on Windows
+    size_t start = rule.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) {
+      return;
+    }
+    rule = rule.substr(start, rule.find_last_not_of(" \t\r\n") - start + 1);
+
+    if (rule.starts_with('#')) {
+      return;
+    }
+
+    Decision decision = Decision::Include;
+    if (rule.starts_with('-')) {
+      decision = Decision::Exclude;
+      rule.remove_prefix(1);
+    } else if (rule.starts_with('+')) {
+      rule.remove_prefix(1);
+    }
+
+    if (rule.ends_with('*')) {
+      rule.remove_suffix(1);
+    }
+
+    uint32_t node = 0;
+    for (char c : rule) {
+      uint32_t child = FindChild(node, c);
+      if (child == kNoNode) {
+        child = static_cast<uint32_t>(m_Nodes.size());
+        m_Nodes[node].children.emplace_back(c, child);
+        m_Nodes.emplace_back();
+      }
+      node = child;
+    }
+    m_Nodes[node].decision = decision;
+  }
+
+  uint32_t FindChild(uint32_t node, char c) const {
+    for (const auto& [childChar, child] : m_Nodes[node].children) {
+      if (childChar == c) {
+        return child;
+      }
+    }
+    return kNoNode;
+  }
+
+  std::vector<Node> m_Nodes;
+};
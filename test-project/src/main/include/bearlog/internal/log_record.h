@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bearlog/internal/log_type_traits.h"
+
+struct LogSlot;
+
+/**
+ * One queued value for the asynchronous writer. Records live in a preallocated ring and are overwritten in
+ * place, so the strings and vectors keep their capacity from earlier values and steady state logging does not
+ * allocate.
+ */
+struct LogRecord {
+  uint64_t timestamp = 0;
+  LogType type = LogType::Boolean;
+  std::string key;
+  // Set instead of the key when the producer already had the key's slot
+  LogSlot* slot = nullptr;
+
+  bool booleanValue = false;
+  double doubleValue = 0.0;
+  int64_t integerValue = 0;
+  std::string stringValue;
+  std::vector<double> doubleArrayValue;
+  std::vector<std::string> stringArrayValue;
+  std::vector<float> floatArrayValue;
+  std::vector<int64_t> integerArrayValue;
+  std::vector<uint8_t> structValue;
+  const StructTypeInfo* structInfo = nullptr;
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, bool value) {
+    SetHeader(newTimestamp, newKey, LogType::Boolean);
+    booleanValue = value;
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, double value) {
+    SetHeader(newTimestamp, newKey, LogType::Double);
+    doubleValue = value;
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, int64_t value) {
+    SetHeader(newTimestamp, newKey, LogType::Integer);
+    integerValue = value;
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, std::string_view value) {
+    SetHeader(newTimestamp, newKey, LogType::String);
+    stringValue.assign(value);
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, std::span<const double> value) {
+    SetHeader(newTimestamp, newKey, LogType::DoubleArray);
+    doubleArrayValue.assign(value.begin(), value.end());
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, std::span<const std::string> value) {
+    SetHeader(newTimestamp, newKey, LogType::StringArray);
+    stringArrayValue.assign(value.begin(), value.end());
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, std::span<const float> value) {
+    SetHeader(newTimestamp, newKey, LogType::FloatArray);
+    floatArrayValue.assign(value.begin(), value.end());
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, std::span<const int64_t> value) {
+    SetHeader(newTimestamp, newKey, LogType::IntegerArray);
+    integerArrayValue.assign(value.begin(), value.end());
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, std::span<const bool> value) {
+    SetHeader(newTimestamp, newKey, LogType::BooleanArray);
+
+    // std::vector<bool> is packed and can't be viewed as a span, so booleans get their own growable buffer
+    if (value.size() > m_BooleanArrayCapacity) {
+      m_BooleanArrayValue = std::make_unique<bool[]>(value.size());
+      m_BooleanArrayCapacity = value.size();
+    }
+    std::copy(value.begin(), value.end(), m_BooleanArrayValue.get());
+    m_BooleanArraySize = value.size();
+  }
+
+  void Set(uint64_t newTimestamp, std::string_view newKey, PackedStruct value) {
+    SetHeader(newTimestamp, newKey, LogType::Struct);
+    structValue.assign(value.data.begin(), value.data.end());
+    structInfo = value.info;
+  }
+
+  std::span<const bool> GetBooleanArray() const {
+    return {m_BooleanArrayValue.get(), m_BooleanArraySize};
+  }
+
+  PackedStruct GetStruct() const {
+    return PackedStruct{structValue, structInfo};
+  }
+
+private:
+  void SetHeader(uint64_t newTimestamp, std::string_view newKey, LogType newType) {
+    timestamp = newTimestamp;
+    key.assign(newKey);
+    type = newType;
+  }
+
+  std::unique_ptr<bool[]> m_BooleanArrayValue;
+  size_t m_BooleanArraySize = 0;
+  size_t m_BooleanArrayCapacity = 0;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bearlog/internal/log_type_traits.h"
+
+// Most sinks BearLog writes to at once, besides DataLogManager and NetworkTables
+constexpr size_t kMaxLogSinks = 4;
+
+/**
+ * One value handed to a sink, already encoded the way .wpilog payloads are.
+ */
+struct SinkRecord {
+  int entry;
+  uint64_t timestamp;
+  std::span<const uint8_t> payload;
+};
+
+/**
+ * Somewhere BearLog writes values, added at runtime with BearLog::AddSink(). A sink sees every value that would be
+ * written to the .wpilog file, after change filters, rate limits and flight recorders, with the key's type fixed
+ * when the key is first written to the sink.
+ *
+ * Sinks are called from whichever thread logs the value, or from the async writer thread in async mode, so they
+ * must be thread safe.
+ */
+class BearLogSink {
+public:
+  virtual ~BearLogSink() = default;
+
+  /**
+   * Start an entry for a key and return its ID, which is passed back with every value for the key. The key has the
+   * same table prefix as in DataLogManager's log, like "NT//Robot/Drive/Speed". typeString is the .wpilog type,
+   * like "double" or "struct:Pose2d".
+   */
+  virtual int StartEntry(std::string_view key, std::string_view typeString, uint64_t timestamp) = 0;
+
+  /**
+   * Write one value. The payload is only valid for the duration of the call.
+   */
+  virtual void Append(int entry, std::span<const uint8_t> payload, uint64_t timestamp) = 0;
+
+  /**
+   * Write several values at once, like a flight recorder dump. Sinks that take a lock can override this to take it
+   * once for the whole batch.
+   */
+  virtual void AppendBatch(std::span<const SinkRecord> records) {
+    for (const SinkRecord& record : records) {
+      Append(record.entry, record.payload, record.timestamp);
+    }
+  }
+
+  /**
+   * Called with the schema of each struct type before the first entry of that type is started. typeString is like
+   * "struct:Pose2d".
+   */
+  virtual void AddSchema(std::string_view typeString, std::string_view schema, uint64_t timestamp) {}
+
+  virtual void Flush() {}
+};
+
+/**
+ * Encode a value the way DataLog writes it into a .wpilog payload. Values that are already laid out that way, like
+ * numeric arrays and structs, are returned without copying. Everything else is written into buffer, which is
+ * appended to so a batch can share one buffer.
+ */
+template<typename T>
+std::span<const uint8_t> EncodeWpilogPayload(typename LogTypeTraits<T>::ValueParam value,
+                                             std::vector<uint8_t>& buffer) {
+  constexpr LogType kType = LogTypeTraits<T>::kType;
+
+  auto appendBytes = [&buffer](const void* data, size_t size) {
+    size_t offset = buffer.size();
+    buffer.resize(offset + size);
+    std::memcpy(buffer.data() + offset, data, size);
+  };
+  auto appendLength = [&appendBytes](size_t length) {
+    auto length32 = static_cast<uint32_t>(length);
+    appendBytes(&length32, sizeof(length32));
+  };
+
+  if constexpr (kType == LogType::Boolean) {
+    buffer.push_back(value ? 1 : 0);
+    return std::span<const uint8_t>(buffer).last(1);
+  } else if constexpr (kType == LogType::Double || kType == LogType::Integer) {
+    appendBytes(&value, 8);
+    return std::span<const uint8_t>(buffer).last(8);
+  } else if constexpr (kType == LogType::String) {
+    return {reinterpret_cast<const uint8_t*>(value.data()), value.size()};
+  } else if constexpr (kType == LogType::StringArray) {
+    // A count, then a length before each string
+    size_t offset = buffer.size();
+    appendLength(value.size());
+    for (const std::string& element : value) {
+      appendLength(element.size());
+      appendBytes(element.data(), element.size());
+    }
+    return std::span<const uint8_t>(buffer).subspan(offset);
+  } else if constexpr (kType == LogType::Struct) {
+    return value.data;
+  } else {
+    // Numeric and boolean arrays are stored element by element in native byte order, which is how they sit in memory
+    return {reinterpret_cast<const uint8_t*>(value.data()), value.size_bytes()};
+  }
+}
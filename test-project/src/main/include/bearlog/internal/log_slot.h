@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string_view>
+
+#include <networktables/ntcore_cpp.h>
+
+#include "bearlog/internal/change_filter.h"
+#include "bearlog/internal/flight_recorder.h"
+#include "bearlog/internal/log_sink.h"
+#include "bearlog/internal/log_type_traits.h"
+#include "bearlog/internal/rate_limiter.h"
+
+/**
+ * The options that apply to one key, worked out once when the key is registered.
+ */
+struct KeySettings {
+  ChangeFilter changeFilter;
+  const RateLimit* dataLogRateLimit = nullptr;
+  const RateLimit* ntRateLimit = nullptr;
+  const FlightRecorder* flightRecorder = nullptr;
+};
+
+/**
+ * Whether a slot's type can still change. Only a slot that Preregister() made and that nothing has been logged to
+ * yet can be replaced, so a type saved in a manifest by an older version of the code doesn't stick.
+ */
+enum class SlotState : uint8_t {
+  Preregistered,
+  // A value of another type is being logged, and the slot is being swapped for one of that type
+  Replacing,
+  Replaced,
+  Logged
+};
+
+/**
+ * Everything BearLog knows about one key, kept together so a single registry lookup feeds both the .wpilog file
+ * and NetworkTables. The DataLog entry and NT publisher are stored as raw handles rather than the typed wrapper
+ * classes, which keeps every slot the same small size no matter what type the key holds.
+ */
+struct LogSlot {
+  LogSlot(std::string_view slotKey, LogType slotType, const StructTypeInfo* slotStructInfo, bool slotLogsToDataLog,
+          const KeySettings& settings, SlotState slotState)
+      : key(slotKey), type(slotType), structInfo(slotStructInfo), logsToDataLog(slotLogsToDataLog), state(slotState) {
+    if (settings.changeFilter.skipUnchanged) {
+      changeFilter = std::make_unique<ChangeFilterState>(settings.changeFilter);
+    }
+    if (settings.dataLogRateLimit) {
+      dataLogRateLimit = std::make_unique<RateLimiterState>(*settings.dataLogRateLimit);
+    }
+    if (settings.ntRateLimit) {
+      ntRateLimit = std::make_unique<RateLimiterState>(*settings.ntRateLimit);
+    }
+    if (settings.flightRecorder && FlightRecorderRing::IsSupported(slotType)) {
+      flightRecorder = std::make_unique<FlightRecorderRing>(settings.flightRecorder->GetCapacity());
+    }
+  }
+
+  LogSlot(const LogSlot&) = delete;
+  LogSlot& operator=(const LogSlot&) = delete;
+
+  ~LogSlot() {
+    NT_Publisher publisher = ntPublisher.load(std::memory_order_relaxed);
+    if (publisher != 0) {
+      nt::Release(publisher);
+    }
+  }
+
+  std::string_view GetTypeString() const {
+    return structInfo ? std::string_view(structInfo->typeString) : GetDataLogTypeString(type);
+  }
+
+  // The key as stored in the registry, which outlives the slot
+  const std::string_view key;
+
+  // The type the key was first logged with. Values of any other type are rejected for this key.
+  const LogType type;
+
+  // Which struct type the key holds when the type is LogType::Struct, nullptr otherwise
+  const StructTypeInfo* const structInfo;
+
+  // Whether the DataLog was being written when the key was registered
+  const bool logsToDataLog;
+
+  std::atomic<SlotState> state;
+
+  // The slot that holds the key's values instead, once this one is Replaced
+  std::atomic<LogSlot*> replacement{nullptr};
+
+  // Entry ID in the DataLog. Started the first time a value is written, so keys the key filter turns off never
+  // show up in the log. 0 until then.
+  std::atomic<int> dataLogEntry{0};
+
+  // Entry IDs in each added sink: (sink id << 32) | entry. Started the first time the key is written to a sink, so
+  // a stale sink id means the entry belongs to a sink that has since been removed.
+  std::array<std::atomic<uint64_t>, kMaxLogSinks> sinkEntries{};
+
+  // Created the first time the key is published, since NetworkTables publishing can be turned on at any time.
+  // 0 until then.
+  std::atomic<NT_Publisher> ntPublisher{0};
+
+  // Last written value for skipping unchanged values. nullptr when the key isn't filtered.
+  std::unique_ptr<ChangeFilterState> changeFilter;
+
+  // Rate caps for each sink. nullptr when the sink takes every value for this key.
+  std::unique_ptr<RateLimiterState> dataLogRateLimit;
+  std::unique_ptr<RateLimiterState> ntRateLimit;
+
+  // Holds the key's recent values in place of writing them to the log file. nullptr when the key is written
+  // straight to the log.
+  std::unique_ptr<FlightRecorderRing> flightRecorder;
+
+  // Cached result of the key filter: (filter generation << 1) | enabled. Only re-evaluated when the filter's
+  // generation changes, so a disabled key costs one load and one branch.
+  std::atomic<uint64_t> keyFilterState{0};
+
+  // Set once a type mismatch has been reported for this key so the warning doesn't repeat every loop
+  std::atomic<bool> typeMismatchReported{false};
+};
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "bearlog/internal/log_type_traits.h"
+
+/**
+ * Counters BearLog keeps about its own overhead. Each thread that logs gets its own counters, which only that
+ * thread writes, so recording a call is a few plain loads and stores with no locked instructions. Collect() adds
+ * them up, either at the end of each cycle through LatchCycle() or on the extras thread when there are no cycles.
+ */
+class LogStats {
+  using Clock = std::chrono::steady_clock;
+
+public:
+  static constexpr size_t kTypeCount = static_cast<size_t>(LogType::Struct) + 1;
+  static constexpr std::array<std::string_view, kTypeCount> kTypeNames = {
+      "Boolean", "Double", "Integer", "String", "DoubleArray", "StringArray", "FloatArray", "IntegerArray",
+      "BooleanArray", "Struct"};
+
+  /**
+   * Everything that happened since the last call to Collect(), plus the running totals.
+   */
+  struct Snapshot {
+    uint64_t calls = 0;
+    uint64_t totalNanos = 0;
+    uint64_t p50Nanos = 0;
+    uint64_t p99Nanos = 0;
+    uint64_t maxNanos = 0;
+    uint64_t bytesAppended = 0;
+    uint64_t newKeys = 0;
+    std::array<uint64_t, kTypeCount> entriesByType{};
+    uint64_t ntPublishers = 0;
+  };
+
+  /**
+   * Times one Log() call. Reads the clock only while stats are turned on.
+   */
+  class CallTimer {
+  public:
+    explicit CallTimer(LogStats& stats) : m_Stats(stats.IsEnabled() ? &stats : nullptr) {
+      if (m_Stats) {
+        m_Start = Clock::now();
+      }
+    }
+
+    ~CallTimer() {
+      if (m_Stats) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_Start);
+        m_Stats->RecordCall(static_cast<uint64_t>(elapsed.count()));
+      }
+    }
+
+    CallTimer(const CallTimer&) = delete;
+    CallTimer& operator=(const CallTimer&) = delete;
+
+  private:
+    LogStats* m_Stats;
+    Clock::time_point m_Start;
+  };
+
+  void SetEnabled(bool enabled) {
+    m_Enabled.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool IsEnabled() const {
+    return m_Enabled.load(std::memory_order_relaxed);
+  }
+
+  void AddBytes(size_t bytes) {
+    if (IsEnabled()) {
+      ThreadStats& stats = GetThreadStats();
+      Increment(stats.bytes, bytes);
+    }
+  }
+
+  // Registrations and publishers are rare, so these are always counted
+  void AddEntry(LogType type) {
+    m_Entries[static_cast<size_t>(type)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void AddPublisher() {
+    m_Publishers.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Collect() at the end of a cycle and keep the result for TakeLatched(), so the counts cover exactly one cycle
+   * rather than however long the extras thread waited between samples.
+   */
+  void LatchCycle() {
+    Snapshot snapshot = Collect();
+    const std::lock_guard<std::mutex> lock(m_LatchMutex);
+    m_Latched = snapshot;
+    m_HasLatched = true;
+    m_LatchesCycles.store(true, std::memory_order_relaxed);
+  }
+
+  // True once any cycle has ended with stats on. Collect() isn't called on its own from then on.
+  bool LatchesCycles() const {
+    return m_LatchesCycles.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * The counts for the last cycle that ended, or nothing if no cycle has ended since the last call.
+   */
+  std::optional<Snapshot> TakeLatched() {
+    const std::lock_guard<std::mutex> lock(m_LatchMutex);
+    if (!m_HasLatched) {
+      return std::nullopt;
+    }
+    m_HasLatched = false;
+    return m_Latched;
+  }
+
+  /**
+   * Add up every thread's counters since the last call.
+   */
+  Snapshot Collect() {
+    const std::lock_guard<std::mutex> collectLock(m_CollectMutex);
+    Snapshot snapshot;
+    std::array<uint32_t, kBuckets> histogram{};
+
+    // Values recorded from here on count towards the next cycle's max
+    uint64_t epoch = m_Epoch.fetch_add(1, std::memory_order_relaxed) & kEpochMask;
+
+    {
+      const std::lock_guard<std::mutex> lock(m_ThreadsMutex);
+
+      for (const std::shared_ptr<ThreadStats>& stats : m_Threads) {
+        snapshot.calls += TakeDelta(stats->calls, stats->lastCalls);
+        snapshot.totalNanos += TakeDelta(stats->nanos, stats->lastNanos);
+        snapshot.bytesAppended += TakeDelta(stats->bytes, stats->lastBytes);
+
+        for (size_t i = 0; i < kBuckets; i++) {
+          uint32_t count = stats->histogram[i].load(std::memory_order_relaxed);
+          histogram[i] += count - stats->lastHistogram[i];
+          stats->lastHistogram[i] = count;
+        }
+
+        uint64_t max = stats->max.load(std::memory_order_relaxed);
+        if ((max >> kNanosBits) == epoch) {
+          snapshot.maxNanos = std::max(snapshot.maxNanos, max & kNanosMask);
+        }
+      }
+    }
+
+    snapshot.p50Nanos = Percentile(histogram, 0.50);
+    snapshot.p99Nanos = Percentile(histogram, 0.99);
+
+    uint64_t totalEntries = 0;
+    for (size_t i = 0; i < kTypeCount; i++) {
+      snapshot.entriesByType[i] = m_Entries[i].load(std::memory_order_relaxed);
+      totalEntries += snapshot.entriesByType[i];
+    }
+    snapshot.newKeys = totalEntries - m_LastTotalEntries;
+    m_LastTotalEntries = totalEntries;
+
+    snapshot.ntPublishers = m_Publishers.load(std::memory_order_relaxed);
+    return snapshot;
+  }
+
+private:
+  // Call times are kept in a histogram with four buckets per power of two, which is within 25% of the real time
+  // and covers everything up to 2^40ns.
+  static constexpr size_t kBuckets = 160;
+  static constexpr int kNanosBits = 40;
+  static constexpr uint64_t kNanosMask = (uint64_t{1} << kNanosBits) - 1;
+  static constexpr uint64_t kEpochMask = (uint64_t{1} << (64 - kNanosBits)) - 1;
+
+  /**
+   * Counters for one thread. The live counters only ever go up, and Collect() keeps the values it saw last time
+   * to work out the change. A thread that exits hands its counters to the next new thread, which just keeps
+   * counting from where it left off.
+   */
+  struct ThreadStats {
+    std::atomic<bool> inUse{true};
+
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> nanos{0};
+    std::atomic<uint64_t> bytes{0};
+    // (epoch << kNanosBits) | slowest call in that epoch
+    std::atomic<uint64_t> max{0};
+    std::array<std::atomic<uint32_t>, kBuckets> histogram{};
+
+    // Only touched by Collect()
+    uint64_t lastCalls = 0;
+    uint64_t lastNanos = 0;
+    uint64_t lastBytes = 0;
+    std::array<uint32_t, kBuckets> lastHistogram{};
+  };
+
+  // Gives the thread's counters back when the thread exits
+  struct ThreadLease {
+    std::shared_ptr<ThreadStats> stats;
+
+    ~ThreadLease() {
+      if (stats) {
+        stats->inUse.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  // Only the owning thread writes a counter, so a load and a store is enough
+  template<typename Counter>
+  static void Increment(std::atomic<Counter>& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + static_cast<Counter>(amount), std::memory_order_relaxed);
+  }
+
+  static uint64_t TakeDelta(const std::atomic<uint64_t>& counter, uint64_t& last) {
+    uint64_t value = counter.load(std::memory_order_relaxed);
+    uint64_t delta = value - last;
+    last = value;
+    return delta;
+  }
+
+  static size_t GetBucket(uint64_t nanos) {
+    if (nanos < 4) {
+      return nanos;
+    }
+    int exponent = std::bit_width(nanos) - 1;
+    size_t bucket = 4 * static_cast<size_t>(exponent - 1) + ((nanos >> (exponent - 2)) & 3);
+    return std::min(bucket, kBuckets - 1);
+  }
+
+  // The largest time that falls into a bucket
+  static uint64_t GetBucketLimit(size_t bucket) {
+    if (bucket < 4) {
+      return bucket;
+    }
+    int exponent = static_cast<int>(bucket / 4) + 1;
+    uint64_t step = uint64_t{1} << (exponent - 2);
+    return (4 + bucket % 4) * step + step - 1;
+  }
+
+  static uint64_t Percentile(const std::array<uint32_t, kBuckets>& histogram, double fraction) {
+    uint64_t total = 0;
+    for (uint32_t count : histogram) {
+      total += count;
+    }
+    if (total == 0) {
+      return 0;
+    }
+
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+      seen += histogram[i];
+      if (seen >= rank) {
+        return GetBucketLimit(i);
+      }
+    }
+    return GetBucketLimit(kBuckets - 1);
+  }
+
+  void RecordCall(uint64_t nanos) {
+    nanos = std::min(nanos, kNanosMask);
+
+    ThreadStats& stats = GetThreadStats();
+    Increment(stats.calls, 1);
+    Increment(stats.nanos, nanos);
+    Increment(stats.histogram[GetBucket(nanos)], 1);
+
+    uint64_t epoch = m_Epoch.load(std::memory_order_relaxed) & kEpochMask;
+    uint64_t max = stats.max.load(std::memory_order_relaxed);
+    if ((max >> kNanosBits) != epoch || (max & kNanosMask) < nanos) {
+      stats.max.store((epoch << kNanosBits) | nanos, std::memory_order_relaxed);
+    }
+  }
+
+  ThreadStats& GetThreadStats() {
+    // There is only ever one LogStats, owned by BearLog, so a single thread_local is enough
+    thread_local ThreadLease lease;
+    if (!lease.stats) {
+      lease.stats = AcquireThreadStats();
+    }
+    return *lease.stats;
+  }
+
+  std::shared_ptr<ThreadStats> AcquireThreadStats() {
+    const std::lock_guard<std::mutex> lock(m_ThreadsMutex);
+
+    for (const std::shared_ptr<ThreadStats>& stats : m_Threads) {
+      bool inUse = false;
+      if (stats->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+        return stats;
+      }
+    }
+
+    m_Threads.push_back(std::make_shared<ThreadStats>());
+    return m_Threads.back();
+  }
+
+  std::atomic<bool> m_Enabled{false};
+  std::atomic<uint64_t> m_Epoch{0};
+
+  // Mutex to protect multiple threads accessing m_Threads
+  std::mutex m_ThreadsMutex;
+  std::vector<std::shared_ptr<ThreadStats>> m_Threads;
+
+  std::array<std::atomic<uint64_t>, kTypeCount> m_Entries{};
+  std::atomic<uint64_t> m_Publishers{0};
+
+  // Cycles can end on more than one thread
+  std::mutex m_CollectMutex;
+  uint64_t m_LastTotalEntries = 0;
+
+  std::mutex m_LatchMutex;
+  Snapshot m_Latched;
+  bool m_HasLatched = false;
+  std::atomic<bool> m_LatchesCycles{false};
+};
+
+/**
+ * Number of bytes a value adds to the .wpilog file, not counting the record header.
+ */
+template<typename T>
+size_t GetAppendedSize(typename LogTypeTraits<T>::ValueParam value) {
+  constexpr LogType kType = LogTypeTraits<T>::kType;
+
+  if constexpr (kType == LogType::Boolean) {
+    return 1;
+  } else if constexpr (kType == LogType::Double || kType == LogType::Integer) {
+    return 8;
+  } else if constexpr (kType == LogType::String) {
+    return value.size();
+  } else if constexpr (kType == LogType::StringArray) {
+    // A count, then a length before each string
+    size_t size = 4;
+    for (const std::string& element : value) {
+      size += 4 + element.size();
+    }
+    return size;
+  } else if constexpr (kType == LogType::Struct) {
+    return value.data.size();
+  } else {
+    return value.size_bytes();
+  }
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <networktables/ntcore_cpp.h>
+#include "wpi/DataLog.h"
+
+#include "bearlog/internal/struct_value.h"
+
+/**
+ * Tag for each value type BearLog can log. Stored with every registered key so that a key keeps the type it was
+ * first logged with.
+ */
+enum class LogType : uint8_t {
+  Boolean,
+  Double,
+  Integer,
+  String,
+  DoubleArray,
+  StringArray,
+  FloatArray,
+  IntegerArray,
+  BooleanArray,
+  // Any wpi::Struct type, or an array of one. The slot's StructTypeInfo says which.
+  Struct
+};
+
+/**
+ * Maps each value type BearLog can log to its type tag and to the DataLog and NetworkTables calls that write it.
+ * ValueParam is the cheapest way to pass a value of that type around.
+ */
+template<typename T>
+struct LogTypeTraits;
+
+template<>
+struct LogTypeTraits<bool> {
+  using ValueParam = bool;
+  static constexpr LogType kType = LogType::Boolean;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendBoolean(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetBoolean(publisher, value, timestamp);
+  }
+};
+
+template<>
+struct LogTypeTraits<double> {
+  using ValueParam = double;
+  static constexpr LogType kType = LogType::Double;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendDouble(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetDouble(publisher, value, timestamp);
+  }
+};
+
+template<>
+struct LogTypeTraits<int64_t> {
+  using ValueParam = int64_t;
+  static constexpr LogType kType = LogType::Integer;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendInteger(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetInteger(publisher, value, timestamp);
+  }
+};
+
+// Plain ints are stored as 64-bit integers in both the log file and NetworkTables
+template<>
+struct LogTypeTraits<int> : LogTypeTraits<int64_t> {};
+
+template<>
+struct LogTypeTraits<std::string> {
+  using ValueParam = std::string_view;
+  static constexpr LogType kType = LogType::String;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendString(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetString(publisher, value, timestamp);
+  }
+};
+
+template<>
+struct LogTypeTraits<std::vector<double>> {
+  using ValueParam = std::span<const double>;
+  static constexpr LogType kType = LogType::DoubleArray;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendDoubleArray(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetDoubleArray(publisher, value, timestamp);
+  }
+};
+
+template<>
+struct LogTypeTraits<std::vector<std::string>> {
+  using ValueParam = std::span<const std::string>;
+  static constexpr LogType kType = LogType::StringArray;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendStringArray(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetStringArray(publisher, value, timestamp);
+  }
+};
+
+template<>
+struct LogTypeTraits<std::vector<float>> {
+  using ValueParam = std::span<const float>;
+  static constexpr LogType kType = LogType::FloatArray;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendFloatArray(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetFloatArray(publisher, value, timestamp);
+  }
+};
+
+template<>
+struct LogTypeTraits<std::vector<int64_t>> {
+  using ValueParam = std::span<const int64_t>;
+  static constexpr LogType kType = LogType::IntegerArray;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendIntegerArray(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetIntegerArray(publisher, value, timestamp);
+  }
+};
+
+// std::vector<bool> is only the tag for boolean arrays. It isn't contiguous, so values are always passed as a
+// span of bools.
+template<>
+struct LogTypeTraits<std::vector<bool>> {
+  using ValueParam = std::span<const bool>;
+  static constexpr LogType kType = LogType::BooleanArray;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendBooleanArray(entry, value, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    // NetworkTables stores boolean arrays as ints
+    thread_local std::vector<int> buffer;
+    buffer.assign(value.begin(), value.end());
+    nt::SetBooleanArray(publisher, buffer, timestamp);
+  }
+};
+
+// Structs are packed before they get here, so every struct type shares these traits
+template<>
+struct LogTypeTraits<PackedStruct> {
+  using ValueParam = PackedStruct;
+  static constexpr LogType kType = LogType::Struct;
+
+  static void Append(wpi::log::DataLog& log, int entry, ValueParam value, int64_t timestamp) {
+    log.AppendRaw(entry, value.data, timestamp);
+  }
+
+  static void Set(NT_Publisher publisher, ValueParam value, int64_t timestamp) {
+    nt::SetRaw(publisher, value.data, timestamp);
+  }
+};
+
+/**
+ * The struct type of a value, or nullptr for every type that isn't a struct.
+ */
+template<typename T>
+const StructTypeInfo* GetStructInfo(typename LogTypeTraits<T>::ValueParam value) {
+  if constexpr (LogTypeTraits<T>::kType == LogType::Struct) {
+    return value.info;
+  } else {
+    return nullptr;
+  }
+}
+
+/**
+ * Element types that can be logged as an array straight from contiguous memory.
+ */
+template<typename T>
+concept ArrayElement = std::same_as<T, double> || std::same_as<T, float> || std::same_as<T, int64_t> ||
+                       std::same_as<T, bool> || std::same_as<T, std::string>;
+
+/**
+ * The type a value is logged as, for values that BearLog converts on the way in.
+ */
+template<typename Value>
+struct LoggedTypeOf {
+  using Type = Value;
+};
+
+template<wpi::StructSerializable S>
+struct LoggedTypeOf<S> {
+  using Type = PackedStruct;
+};
+
+template<>
+struct LoggedTypeOf<int> {
+  using Type = int64_t;
+};
+
+template<>
+struct LoggedTypeOf<float> {
+  using Type = double;
+};
+
+template<std::ranges::contiguous_range Range>
+  requires ArrayElement<std::ranges::range_value_t<Range>>
+struct LoggedTypeOf<Range> {
+  using Type = std::vector<std::ranges::range_value_t<Range>>;
+};
+
+template<StructRange Range>
+struct LoggedTypeOf<Range> {
+  using Type = PackedStruct;
+};
+
+/**
+ * Type string used for the entry in the .wpilog file. These match the strings the typed wpi::log::*LogEntry
+ * classes use so that AdvantageScope decodes the entries the same way.
+ */
+inline std::string_view GetDataLogTypeString(LogType type) {
+  switch (type) {
+    case LogType::Boolean: return "boolean";
+    case LogType::Double: return "double";
+    case LogType::Integer: return "int64";
+    case LogType::String: return "string";
+    case LogType::DoubleArray: return "double[]";
+    case LogType::StringArray: return "string[]";
+    case LogType::FloatArray: return "float[]";
+    case LogType::IntegerArray: return "int64[]";
+    case LogType::BooleanArray: return "boolean[]";
+    case LogType::Struct: return "raw";
+  }
+  return "raw";
+}
+
+/**
+ * The type tag for a .wpilog type string, or nothing if it isn't a type that can be registered by name. Struct types
+ * need their C++ type to register, so they aren't included.
+ */
+inline std::optional<LogType> ParseDataLogTypeString(std::string_view typeString) {
+  for (LogType type : {LogType::Boolean, LogType::Double, LogType::Integer, LogType::String, LogType::DoubleArray,
+                       LogType::StringArray, LogType::FloatArray, LogType::IntegerArray, LogType::BooleanArray}) {
+    if (GetDataLogTypeString(type) == typeString) {
+      return type;
+    }
+  }
+  return std::nullopt;
+}
+
+/**
+ * Type string used for the NetworkTables topic.
+ */
+inline std::string_view GetNetworkTablesTypeString(LogType type) {
+  switch (type) {
+    case LogType::Boolean: return "boolean";
+    case LogType::Double: return "double";
+    case LogType::Integer: return "int";
+    case LogType::String: return "string";
+    case LogType::DoubleArray: return "double[]";
+    case LogType::StringArray: return "string[]";
+    case LogType::FloatArray: return "float[]";
+    case LogType::IntegerArray: return "int[]";
+    case LogType::BooleanArray: return "boolean[]";
+    case LogType::Struct: return "raw";
+  }
+  return "raw";
+}
+
+inline NT_Type GetNetworkTablesType(LogType type) {
+  switch (type) {
+    case LogType::Boolean: return NT_BOOLEAN;
+    case LogType::Double: return NT_DOUBLE;
+    case LogType::Integer: return NT_INTEGER;
+    case LogType::String: return NT_STRING;
+    case LogType::DoubleArray: return NT_DOUBLE_ARRAY;
+    case LogType::StringArray: return NT_STRING_ARRAY;
+    case LogType::FloatArray: return NT_FLOAT_ARRAY;
+    case LogType::IntegerArray: return NT_INTEGER_ARRAY;
+    case LogType::BooleanArray: return NT_BOOLEAN_ARRAY;
+    case LogType::Struct: return NT_RAW;
+  }
+  return NT_RAW;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/**
+ * What to do when a producer finds the ring full.
+ */
+enum class RingOverflowPolicy {
+  // Throw away the oldest queued item to make room for the new one
+  DropOldest,
+  // Throw away the new item and keep everything that is already queued
+  DropNewest,
+  // Wait for the consumer to make room. Never loses data, but can stall the producer.
+  Block
+};
+
+/**
+ * Bounded lock-free multi-producer queue based on Dmitry Vyukov's bounded MPMC queue. Each cell carries a
+ * sequence number that tells producers and consumers whose turn it is, so pushing only costs one CAS on the
+ * enqueue position.
+ *
+ * Items are never constructed or destroyed after the ring is created. Producers fill a cell in place and the
+ * consumer reads it in place, which lets items like std::string and std::vector keep their capacity between
+ * uses so a warmed up ring does not allocate.
+ */
+template<typename T>
+class MpscRing {
+public:
+  explicit MpscRing(size_t capacity)
+      : m_Capacity(std::bit_ceil(capacity < 2 ? size_t{2} : capacity)),
+        m_Mask(m_Capacity - 1),
+        m_Cells(std::make_unique<Cell[]>(m_Capacity)) {
+    for (size_t i = 0; i < m_Capacity; i++) {
+      m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  /**
+   * Claim a cell and call fill(T&) on it. Returns false without calling fill if the ring is full.
+   */
+  template<typename Fill>
+  bool TryPush(Fill&& fill) {
+    size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &m_Cells[pos & m_Mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_EnqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    fill(cell->data);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Push using the given overflow policy. Returns the number of items that were dropped to handle an overflow.
+   */
+  template<typename Fill>
+  size_t Push(RingOverflowPolicy policy, Fill&& fill) {
+    size_t dropped = 0;
+    while (!TryPush(fill)) {
+      switch (policy) {
+        case RingOverflowPolicy::DropNewest:
+          return 1;
+        case RingOverflowPolicy::DropOldest:
+          // Dequeuing is safe from any thread, so the producer can discard the oldest item itself. Another
+          // producer can take the freed cell first, in which case we go around and drop again.
+          if (TryPop([](T&) {})) {
+            dropped++;
+          }
+          break;
+        case RingOverflowPolicy::Block:
+          std::this_thread::yield();
+          break;
+      }
+    }
+    return dropped;
+  }
+
+  /**
+   * Take the oldest cell and call consume(T&) on it. Returns false if the ring is empty.
+   */
+  template<typename Consume>
+  bool TryPop(Consume&& consume) {
+    size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &m_Cells[pos & m_Mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_DequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    consume(cell->data);
+    cell->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t GetCapacity() const {
+    return m_Capacity;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  const size_t m_Capacity;
+  const size_t m_Mask;
+  std::unique_ptr<Cell[]> m_Cells;
+
+  // Keep the producer and consumer positions on separate cache lines so they don't fight over ownership
+  alignas(64) std::atomic<size_t> m_EnqueuePos{0};
+  alignas(64) std::atomic<size_t> m_DequeuePos{0};
+};
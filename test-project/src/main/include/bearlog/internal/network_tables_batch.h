@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <networktables/ntcore_cpp.h>
+
+#include "bearlog/internal/log_record.h"
+#include "bearlog/internal/log_type_traits.h"
+
+/**
+ * NetworkTables values one thread has logged during its current cycle, held back so the whole cycle can be handed
+ * to NetworkTables at once when the cycle ends. Dashboards then never see half of one loop's values next to half
+ * of the previous loop's.
+ */
+class NetworkTablesBatch {
+public:
+  template<typename T>
+  void Stage(NT_Publisher publisher, typename LogTypeTraits<T>::ValueParam value, uint64_t timestamp) {
+    if (m_Size == m_Staged.size()) {
+      m_Staged.emplace_back();
+    }
+
+    StagedValue& staged = m_Staged[m_Size++];
+    staged.publisher = publisher;
+    staged.record.Set(timestamp, {}, value);
+  }
+
+  /**
+   * Set every staged value on its publisher, in the order they were logged, then start a new batch.
+   */
+  void Apply() {
+    for (size_t i = 0; i < m_Size; i++) {
+      Set(m_Staged[i].publisher, m_Staged[i].record);
+    }
+    m_Size = 0;
+  }
+
+  bool IsEmpty() const {
+    return m_Size == 0;
+  }
+
+private:
+  struct StagedValue {
+    NT_Publisher publisher = 0;
+    LogRecord record;
+  };
+
+  static void Set(NT_Publisher publisher, const LogRecord& record) {
+    int64_t timestamp = static_cast<int64_t>(record.timestamp);
+
+    switch (record.type) {
+      case LogType::Boolean:
+        LogTypeTraits<bool>::Set(publisher, record.booleanValue, timestamp);
+        break;
+      case LogType::Double:
+        LogTypeTraits<double>::Set(publisher, record.doubleValue, timestamp);
+        break;
+      case LogType::Integer:
+        LogTypeTraits<int64_t>::Set(publisher, record.integerValue, timestamp);
+        break;
+      case LogType::String:
+        LogTypeTraits<std::string>::Set(publisher, record.stringValue, timestamp);
+        break;
+      case LogType::DoubleArray:
+        LogTypeTraits<std::vector<double>>::Set(publisher, record.doubleArrayValue, timestamp);
+        break;
+      case LogType::StringArray:
+        LogTypeTraits<std::vector<std::string>>::Set(publisher, record.stringArrayValue, timestamp);
+        break;
+      case LogType::FloatArray:
+        LogTypeTraits<std::vector<float>>::Set(publisher, record.floatArrayValue, timestamp);
+        break;
+      case LogType::IntegerArray:
+        LogTypeTraits<std::vector<int64_t>>::Set(publisher, record.integerArrayValue, timestamp);
+        break;
+      case LogType::BooleanArray:
+        LogTypeTraits<std::vector<bool>>::Set(publisher, record.GetBooleanArray(), timestamp);
+        break;
+      case LogType::Struct:
+        LogTypeTraits<PackedStruct>::Set(publisher, record.GetStruct(), timestamp);
+        break;
+    }
+  }
+
+  std::vector<StagedValue> m_Staged;
+  size_t m_Size = 0;
+};
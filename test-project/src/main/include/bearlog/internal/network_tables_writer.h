@@ -1,17 +1,24 @@
 #pragma once
 
-#include <unordered_map>
+#include <memory>
+#include <string>
+#include <string_view>
 
-#include <networktables/BooleanTopic.h>
-#include <networktables/DoubleArrayTopic.h>
-#include <networktables/DoubleTopic.h>
-#include <networktables/IntegerTopic.h>
-#include <networktables/StringArrayTopic.h>
-#include <networktables/StringTopic.h>
 #include <networktables/NetworkTable.h>
 #include <networktables/NetworkTableInstance.h>
+#include <networktables/ntcore_cpp.h>
 #include <wpi/json.h>
 
+#include "bearlog/internal/log_type_traits.h"
+
+/**
+ * NetworkTables publisher options for every key that starts with the prefix. An empty prefix matches every key.
+ */
+struct PublishOptions {
+  std::string prefix;
+  nt::PubSubOptions options;
+};
+
 class NetworkTablesWriter {
 public:
   const wpi::json kTopicProperties = {{"source", "\"BearLog\""}};
@@ -20,85 +27,29 @@ public:
     m_LogTable = nt::NetworkTableInstance::GetDefault().GetTable(logTable);
   }
 
-  void Log(uint64_t timestamp, std::string key, bool value) {
-    if (m_BooleanPublishers.contains(key)) {
-      m_BooleanPublishers.at(key)->Set(value, timestamp);
-    } else {
-      nt::BooleanTopic topic = m_LogTable->GetBooleanTopic(key);
-      std::unique_ptr<nt::BooleanPublisher> new_publisher = std::make_unique<nt::BooleanPublisher>(topic.Publish());
-      new_publisher->Set(value, timestamp);
-      topic.SetProperties(kTopicProperties);
-      m_BooleanPublishers[key] = std::move(new_publisher);
-    }
-  }
-
-  void Log(uint64_t timestamp, std::string key, std::span<const double> value) {
-    if (m_DoubleArrayPublishers.contains(key)) {
-      m_DoubleArrayPublishers.at(key)->Set(value, timestamp);
-    } else {
-      nt::DoubleArrayTopic topic = m_LogTable->GetDoubleArrayTopic(key);
-      std::unique_ptr<nt::DoubleArrayPublisher> new_publisher = std::make_unique<nt::DoubleArrayPublisher>(topic.Publish());
-      new_publisher->Set(value, timestamp);
-      topic.SetProperties(kTopicProperties);
-      m_DoubleArrayPublishers[key] = std::move(new_publisher);
+  /**
+   * Create the topic and a publisher for a key. The caller owns the returned publisher handle. Struct topics also
+   * get their schema published.
+   */
+  NT_Publisher Publish(std::string_view key, LogType type, const StructTypeInfo* structInfo,
+                       const nt::PubSubOptions& options) {
+    std::string_view typeString = GetNetworkTablesTypeString(type);
+    if (structInfo) {
+      structInfo->addNetworkTablesSchema();
+      typeString = structInfo->typeString;
     }
-  }
 
-  void Log(uint64_t timestamp, std::string key, double value) {
-    if (m_DoublePublishers.contains(key)) {
-      m_DoublePublishers.at(key)->Set(value, timestamp);
-    } else {
-      nt::DoubleTopic topic = m_LogTable->GetDoubleTopic(key);
-      std::unique_ptr<nt::DoublePublisher> new_publisher = std::make_unique<nt::DoublePublisher>(topic.Publish());
-      new_publisher->Set(value, timestamp);
-      topic.SetProperties(kTopicProperties);
-      m_DoublePublishers[key] = std::move(new_publisher);
-    }
+    nt::Topic topic = m_LogTable->GetTopic(key);
+    NT_Publisher publisher = nt::Publish(topic.GetHandle(), GetNetworkTablesType(type), typeString, options);
+    topic.SetProperties(kTopicProperties);
+    return publisher;
   }
 
-  void Log(uint64_t timestamp, std::string key, int value) {
-    if (m_IntegerPublishers.contains(key)) {
-      m_IntegerPublishers.at(key)->Set(value, timestamp);
-    } else {
-      nt::IntegerTopic topic = m_LogTable->GetIntegerTopic(key);
-      std::unique_ptr<nt::IntegerPublisher> new_publisher = std::make_unique<nt::IntegerPublisher>(topic.Publish());
-      new_publisher->Set(value, timestamp);
-      topic.SetProperties(kTopicProperties);
-      m_IntegerPublishers[key] = std::move(new_publisher);
-    }
-  }
-
-  void Log(uint64_t timestamp, std::string key, std::span<const std::string> value) {
-    if (m_StringArrayPublishers.contains(key)) {
-      m_StringArrayPublishers.at(key)->Set(value, timestamp);
-    } else {
-      nt::StringArrayTopic topic = m_LogTable->GetStringArrayTopic(key);
-      std::unique_ptr<nt::StringArrayPublisher> new_publisher = std::make_unique<nt::StringArrayPublisher>(topic.Publish());
-      new_publisher->Set(value, timestamp);
-      topic.SetProperties(kTopicProperties);
-      m_StringArrayPublishers[key] = std::move(new_publisher);
-    }
-  }
-
-  void Log(uint64_t timestamp, std::string key, const std::string& value) {
-    if (m_StringPublishers.contains(key)) {
-      m_StringPublishers.at(key)->Set(value, timestamp);
-    } else {
-      nt::StringTopic topic = m_LogTable->GetStringTopic(key);
-      std::unique_ptr<nt::StringPublisher> new_publisher = std::make_unique<nt::StringPublisher>(topic.Publish());
-      new_publisher->Set(value, timestamp);
-      topic.SetProperties(kTopicProperties);
-      m_StringPublishers[key] = std::move(new_publisher);
-    }
+  template<typename T>
+  void Set(NT_Publisher publisher, typename LogTypeTraits<T>::ValueParam value, uint64_t timestamp) {
+    LogTypeTraits<T>::Set(publisher, value, timestamp);
   }
 
 private:
   std::shared_ptr<nt::NetworkTable> m_LogTable;
-
-  std::unordered_map<std::string, std::unique_ptr<nt::BooleanPublisher>> m_BooleanPublishers;
-  std::unordered_map<std::string, std::unique_ptr<nt::DoubleArrayPublisher>> m_DoubleArrayPublishers;
-  std::unordered_map<std::string, std::unique_ptr<nt::DoublePublisher>> m_DoublePublishers;
-  std::unordered_map<std::string, std::unique_ptr<nt::IntegerPublisher>> m_IntegerPublishers;
-  std::unordered_map<std::string, std::unique_ptr<nt::StringArrayPublisher>> m_StringArrayPublishers;
-  std::unordered_map<std::string, std::unique_ptr<nt::StringPublisher>> m_StringPublishers;
 };
\ No newline at end of file
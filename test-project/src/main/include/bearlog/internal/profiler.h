@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bearlog/internal/concurrent_key_registry.h"
+
+/**
+ * Set BEARLOG_ENABLE_PROFILING to 0 to compile out every BEARLOG_PROFILE_SCOPE(). Only the macro depends on it, so
+ * BearLog is the same class in every file and the setting can differ between them.
+ */
+#ifndef BEARLOG_ENABLE_PROFILING
+#define BEARLOG_ENABLE_PROFILING 1
+#endif
+
+/**
+ * A named block of code being timed. The id picks out the scope's accumulator in each thread's buffer.
+ */
+struct ProfileScope {
+  const size_t id;
+  // Key the scope's times are logged to
+  const std::string key;
+};
+
+/**
+ * Time spent in one scope by one thread since the last flush.
+ */
+struct ProfileAccumulator {
+  uint64_t totalNanos = 0;
+  uint64_t count = 0;
+  uint64_t maxNanos = 0;
+};
+
+/**
+ * Collects scope times into per-thread buffers so that timing a scope never takes a lock or touches memory shared
+ * with another thread. Each thread flushes its own buffer at the end of its cycle, so only threads that run cycles
+ * record anything.
+ */
+class Profiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::string_view kKeyPrefix = "Profile/";
+
+  const ProfileScope& GetScope(std::string_view name) {
+    return m_Scopes.GetOrCreate(name, [&] {
+      size_t id = m_NextId.fetch_add(1, std::memory_order_relaxed);
+      return ProfileScope{id, std::string(kKeyPrefix) + std::string(name)};
+    });
+  }
+
+  /**
+   * Name a scope after the function it is in, e.g. "Drive/Periodic" for Drive::Periodic().
+   */
+  const ProfileScope& GetScope(const std::source_location& location) {
+    std::string_view function = location.function_name();
+    function = function.substr(0, function.find('('));
+    function = function.substr(function.rfind(' ') + 1);
+
+    std::string name;
+    for (size_t i = 0; i < function.size(); i++) {
+      if (function.compare(i, 2, "::") == 0) {
+        name += '/';
+        i++;
+      } else {
+        name += function[i];
+      }
+    }
+    return GetScope(name);
+  }
+
+  static void Record(const ProfileScope& scope, uint64_t nanos) {
+    ThreadBuffer& buffer = GetThreadBuffer();
+    if (scope.id >= buffer.accumulators.size()) {
+      buffer.accumulators.resize(scope.id + 1);
+    }
+
+    ProfileAccumulator& accumulator = buffer.accumulators[scope.id];
+    if (accumulator.count == 0) {
+      buffer.active.push_back(&scope);
+    }
+    accumulator.totalNanos += nanos;
+    accumulator.count++;
+    accumulator.maxNanos = std::max(accumulator.maxNanos, nanos);
+  }
+
+  /**
+   * Call write(scope, accumulator) for every scope this thread timed since the last flush, then start over.
+   */
+  template<typename Write>
+  static void Flush(Write&& write) {
+    ThreadBuffer& buffer = GetThreadBuffer();
+    for (const ProfileScope* scope : buffer.active) {
+      write(*scope, buffer.accumulators[scope->id]);
+      buffer.accumulators[scope->id] = ProfileAccumulator{};
+    }
+    buffer.active.clear();
+  }
+
+private:
+  // The vectors keep their capacity, so a thread's buffer stops allocating once it has seen all of its scopes
+  struct ThreadBuffer {
+    std::vector<ProfileAccumulator> accumulators;
+    std::vector<const ProfileScope*> active;
+  };
+
+  static ThreadBuffer& GetThreadBuffer() {
+    thread_local ThreadBuffer buffer;
+    return buffer;
+  }
+
+  ConcurrentKeyRegistry<ProfileScope> m_Scopes;
+  std::atomic<size_t> m_NextId{0};
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <units/frequency.h>
+
+#include "bearlog/internal/log_type_traits.h"
+
+/**
+ * How values are reduced when a sink only accepts a limited rate for a key.
+ */
+enum class Decimation {
+  // Write the newest value once per period
+  Latest,
+  // Write the smallest and largest value seen during each period, in the order they happened. Keeps spikes
+  // visible at a fraction of the rate.
+  MinMax,
+  // Write the average of the values seen during each period
+  Mean
+};
+
+/**
+ * A rate cap for every key that starts with the prefix. An empty prefix matches every key. A rate of 0Hz or less
+ * means values are never written to that sink.
+ */
+struct RateLimit {
+  std::string prefix;
+  units::hertz_t rate;
+  Decimation decimation = Decimation::Latest;
+};
+
+/**
+ * Find the rule with the longest matching prefix for a key, or nullptr if no rule matches. Works for any rule type
+ * with a prefix member.
+ */
+template<typename Rule>
+const Rule* FindPrefixRule(const std::vector<Rule>& rules, std::string_view key) {
+  const Rule* best = nullptr;
+  for (const Rule& rule : rules) {
+    if (key.starts_with(rule.prefix) && (!best || rule.prefix.size() > best->prefix.size())) {
+      best = &rule;
+    }
+  }
+  return best;
+}
+
+/**
+ * Per key, per sink state for a RateLimit. Values are accumulated into a window, and when a value arrives after
+ * the window has run for a full period, the reduced value for the window is written and a new window starts.
+ * The very first value for a key is always written right away.
+ *
+ * MinMax and Mean only apply to doubles and integers. Every other type uses Latest. Nothing here allocates, so a
+ * rate limited key costs the same per call as an unlimited one.
+ */
+class RateLimiterState {
+public:
+  explicit RateLimiterState(const RateLimit& limit)
+      : m_PeriodMicros(ToPeriodMicros(limit.rate)),
+        m_Decimation(limit.decimation) {
+  }
+
+  /**
+   * Add a value to the current window. write(value, timestamp) is called for each value that should actually be
+   * written to the sink, which can be zero, one or two times.
+   */
+  template<typename T, typename Write>
+  void Sample(typename LogTypeTraits<T>::ValueParam value, uint64_t timestamp, Write&& write) {
+    constexpr LogType kType = LogTypeTraits<T>::kType;
+    constexpr bool kIsNumber = kType == LogType::Double || kType == LogType::Integer;
+
+    if (m_PeriodMicros == kNever) {
+      return;
+    }
+
+    // Values for one key can come from more than one thread
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (!m_Started) {
+      m_Started = true;
+      m_WindowStart = timestamp;
+      write(value, timestamp);
+      return;
+    }
+
+    if constexpr (kIsNumber) {
+      Accumulate(static_cast<double>(value), timestamp);
+    }
+
+    if (timestamp - m_WindowStart < m_PeriodMicros) {
+      return;
+    }
+
+    if constexpr (kIsNumber) {
+      using Value = typename LogTypeTraits<T>::ValueParam;
+
+      switch (m_Decimation) {
+        case Decimation::Latest:
+          write(value, timestamp);
+          break;
+        case Decimation::MinMax:
+          if (m_MinTimestamp == m_MaxTimestamp) {
+            write(static_cast<Value>(m_Min), m_MinTimestamp);
+          } else if (m_MinTimestamp < m_MaxTimestamp) {
+            write(static_cast<Value>(m_Min), m_MinTimestamp);
+            write(static_cast<Value>(m_Max), m_MaxTimestamp);
+          } else {
+            write(static_cast<Value>(m_Max), m_MaxTimestamp);
+            write(static_cast<Value>(m_Min), m_MinTimestamp);
+          }
+          break;
+        case Decimation::Mean:
+          if constexpr (kType == LogType::Integer) {
+            write(static_cast<Value>(std::llround(m_Sum / m_Count)), timestamp);
+          } else {
+            write(m_Sum / m_Count, timestamp);
+          }
+          break;
+      }
+      ResetWindow();
+    } else {
+      write(value, timestamp);
+    }
+
+    m_WindowStart = timestamp;
+  }
+
+  /**
+   * Returns true if a value logged at this time would affect what gets written. Under Latest, values that arrive
+   * in the middle of a window are thrown away, so they don't need to be computed at all.
+   */
+  template<typename T>
+  bool WantsSample(uint64_t timestamp) {
+    constexpr LogType kType = LogTypeTraits<T>::kType;
+    constexpr bool kIsNumber = kType == LogType::Double || kType == LogType::Integer;
+
+    if (m_PeriodMicros == kNever) {
+      return false;
+    }
+    if (kIsNumber && m_Decimation != Decimation::Latest) {
+      return true;
+    }
+
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return !m_Started || (timestamp - m_WindowStart) >= m_PeriodMicros;
+  }
+
+private:
+  static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+  static uint64_t ToPeriodMicros(units::hertz_t rate) {
+    // Written this way round so NaN is caught too
+    if (!(rate.value() > 0)) {
+      return kNever;
+    }
+    // Rates too slow for the period to fit still write the first value
+    double periodMicros = 1e6 / rate.value();
+    return periodMicros < static_cast<double>(kNever) ? static_cast<uint64_t>(periodMicros) : kNever - 1;
+  }
+
+  void Accumulate(double value, uint64_t timestamp) {
+    if (m_Count == 0 || value < m_Min) {
+      m_Min = value;
+      m_MinTimestamp = timestamp;
+    }
+    if (m_Count == 0 || value > m_Max) {
+      m_Max = value;
+      m_MaxTimestamp = timestamp;
+    }
+    m_Sum += value;
+    m_Count++;
+  }
+
+  void ResetWindow() {
+    m_Count = 0;
+    m_Sum = 0.0;
+  }
+
+  const uint64_t m_PeriodMicros;
+  const Decimation m_Decimation;
+
+  std::mutex m_Mutex;
+  bool m_Started = false;
+  uint64_t m_WindowStart = 0;
+
+  size_t m_Count = 0;
+  double m_Sum = 0.0;
+  double m_Min = 0.0;
+  double m_Max = 0.0;
+  uint64_t m_MinTimestamp = 0;
+  uint64_t m_MaxTimestamp = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <networktables/NetworkTableInstance.h>
+#include <wpi/struct/Struct.h>
+#include "wpi/DataLog.h"
+
+/**
+ * What BearLog needs to know about one struct type once its values have been packed into bytes. There is one of
+ * these for each struct type (and one more for arrays of it), so a slot can check that a key keeps the same struct
+ * type by comparing pointers.
+ */
+struct StructTypeInfo {
+  // "struct:Pose2d" for single values, "struct:Pose2d[]" for arrays
+  std::string typeString;
+
+  // Add the schema for the type, and every struct nested in it. Both DataLog and NetworkTables skip schemas they
+  // already have, so these are safe to call once per key.
+  void (*addDataLogSchema)(wpi::log::DataLog& log, int64_t timestamp);
+  void (*addNetworkTablesSchema)();
+
+  // Call fn(typeString, schema) for the type and every struct nested in it, nested ones first. For sinks that write
+  // their own schemas.
+  void (*forEachSchema)(const std::function<void(std::string_view, std::string_view)>& fn);
+};
+
+template<wpi::StructSerializable S, bool kIsArray>
+const StructTypeInfo& GetStructTypeInfo() {
+  static const StructTypeInfo info{
+      "struct:" + std::string(wpi::Struct<S>::GetTypeName()) + (kIsArray ? "[]" : ""),
+      [](wpi::log::DataLog& log, int64_t timestamp) { log.AddStructSchema<S>(timestamp); },
+      [] { nt::NetworkTableInstance::GetDefault().AddStructSchema<S>(); },
+      [](const std::function<void(std::string_view, std::string_view)>& fn) { wpi::ForEachStructSchema<S>(fn); }};
+  return info;
+}
+
+/**
+ * A contiguous container of struct values, like std::array<frc::SwerveModuleState, 4>.
+ */
+template<typename Range>
+concept StructRange =
+    std::ranges::contiguous_range<Range> && wpi::StructSerializable<std::ranges::range_value_t<Range>>;
+
+/**
+ * A struct value, or an array of them, already packed into the bytes that get written to the log. Packing on the
+ * calling thread means the rest of BearLog, including the async queue, only ever sees bytes.
+ */
+struct PackedStruct {
+  std::span<const uint8_t> data;
+  const StructTypeInfo* info;
+};
+
+template<wpi::StructSerializable S>
+PackedStruct PackStructValue(const S& value) {
+  // The returned data is only valid until the next value is packed on this thread
+  thread_local std::vector<uint8_t> buffer;
+  buffer.resize(wpi::GetStructSize<S>());
+  wpi::PackStruct(std::span<uint8_t>(buffer), value);
+
+  return PackedStruct{buffer, &GetStructTypeInfo<S, false>()};
+}
+
+template<wpi::StructSerializable S>
+PackedStruct PackStructArray(std::span<const S> values) {
+  constexpr size_t kSize = wpi::GetStructSize<S>();
+
+  thread_local std::vector<uint8_t> buffer;
+  buffer.resize(values.size() * kSize);
+  for (size_t i = 0; i < values.size(); i++) {
+    wpi::PackStruct(std::span<uint8_t>(buffer).subspan(i * kSize, kSize), values[i]);
+  }
+
+  return PackedStruct{buffer, &GetStructTypeInfo<S, true>()};
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <string_view>
+
+#include <units/base.h>
+
+/**
+ * Any WPILib units type, e.g. units::meter_t. These are logged as a double with the unit abbreviation added to
+ * the key.
+ */
+template<typename T>
+concept UnitType = units::traits::is_unit_t<T>::value && requires(const T& value) {
+  { value.value() } -> std::convertible_to<double>;
+  { value.abbreviation() } -> std::convertible_to<std::string_view>;
+};
+
+/**
+ * The "(abbreviation)" suffix for a units type, built at compile time. For units::meter_t, kValue is "(m)".
+ */
+template<UnitType Units>
+struct UnitSuffix {
+private:
+  static constexpr std::string_view kAbbreviation = Units{}.abbreviation();
+
+  static constexpr std::array<char, kAbbreviation.size() + 2> kBuffer = [] {
+    std::array<char, kAbbreviation.size() + 2> buffer{};
+    buffer.front() = '(';
+    for (size_t i = 0; i < kAbbreviation.size(); i++) {
+      buffer[i + 1] = kAbbreviation[i];
+    }
+    buffer.back() = ')';
+    return buffer;
+  }();
+
+public:
+  static constexpr std::string_view kValue{kBuffer.data(), kBuffer.size()};
+};
@@ -0,0 +1,603 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bearlog/reader/wpilog_reader.h"
+
+/**
+ * Every value logged to one key, stored as columns: one array of timestamps and the raw payloads back to back.
+ * Booleans, integers, floats and doubles have a fixed size, so row i's payload is at i * GetFixedSize(). Every
+ * other type also keeps offsets, where row i is data[offsets[i], offsets[i + 1]).
+ */
+struct WpilogColumn {
+  std::string name;
+  std::string type;
+  std::string metadata;
+
+  std::vector<int64_t> timestamps;
+  std::vector<uint8_t> data;
+  std::vector<uint64_t> offsets;
+
+  // Payload size for fixed size types, or 0 if the type has offsets
+  static size_t GetFixedSize(std::string_view type) {
+    if (type == "boolean") {
+      return 1;
+    }
+    if (type == "float") {
+      return 4;
+    }
+    if (type == "int64" || type == "double") {
+      return 8;
+    }
+    return 0;
+  }
+
+  size_t GetFixedSize() const {
+    return GetFixedSize(type);
+  }
+
+  size_t GetRowCount() const {
+    return timestamps.size();
+  }
+
+  std::span<const uint8_t> GetPayload(size_t row) const {
+    size_t fixedSize = GetFixedSize();
+    if (fixedSize != 0) {
+      return std::span<const uint8_t>(data).subspan(row * fixedSize, fixedSize);
+    }
+    return std::span<const uint8_t>(data).subspan(offsets[row], offsets[row + 1] - offsets[row]);
+  }
+};
+
+struct WpilogExtractOptions {
+  // Metadata BearLog's DataLogWriter adds to every entry it starts
+  static constexpr std::string_view kBearLogSource = "\"source\":\"BearLog\"";
+
+  // Only keep entries that BearLog created
+  bool bearLogOnly = true;
+  // Only keep entries whose names start with one of these. Keep every entry if empty.
+  std::vector<std::string> prefixes;
+  // Threads to decode with, or 0 for one per core
+  unsigned threadCount = 0;
+  // Records are decoded in chunks of roughly this many bytes, one chunk per thread at a time
+  size_t chunkSize = size_t{8} << 20;
+
+  bool Matches(const WpilogStart& start) const {
+    if (bearLogOnly && start.metadata.find(kBearLogSource) == std::string_view::npos) {
+      return false;
+    }
+    if (prefixes.empty()) {
+      return true;
+    }
+    return std::any_of(prefixes.begin(), prefixes.end(),
+                       [&](const std::string& prefix) { return start.name.starts_with(prefix); });
+  }
+};
+
+/**
+ * Pulls the selected entries out of a .wpilog file into one WpilogColumn per key. A first pass over the record
+ * headers sizes every column and splits the file into chunks, then the chunks are decoded in parallel straight into
+ * their place in the columns.
+ */
+class WpilogExtractor {
+public:
+  /**
+   * Returns false, with the reason in GetError(), if the file is corrupt.
+   */
+  bool Extract(const WpilogReader& reader, const WpilogExtractOptions& options) {
+    m_Columns.clear();
+    m_FixedSizes.clear();
+    m_Chunks.clear();
+    m_Mappings.clear();
+    m_StartColumns.clear();
+    m_RecordCount = 0;
+
+    if (!Index(reader, options)) {
+      return false;
+    }
+    Allocate();
+    Decode(reader, options);
+    return true;
+  }
+
+  const std::string& GetError() const {
+    return m_Error;
+  }
+
+  std::vector<WpilogColumn>& GetColumns() {
+    return m_Columns;
+  }
+
+  // Every record in the file, including control records and records for entries that weren't selected
+  uint64_t GetRecordCount() const {
+    return m_RecordCount;
+  }
+
+private:
+  // Entry ids are handed out in order by DataLog, so anything this large means the file is corrupt
+  static constexpr uint32_t kMaxEntryId = 1 << 24;
+
+  struct Chunk {
+    size_t begin = 0;
+    size_t end = 0;
+    // Which entry id to column mapping was in effect at the start of the chunk
+    size_t mapping = 0;
+    // Rows and payload bytes for each column. Counts after the first pass, where the chunk's rows start after
+    // Allocate(). Columns added after the chunk ended are missing, which means 0.
+    std::vector<uint64_t> rows;
+    std::vector<uint64_t> bytes;
+  };
+
+  // A record is only kept if its payload fits its type, which both passes must agree on
+  bool IsValidPayload(size_t column, const WpilogRecord& record) const {
+    size_t fixedSize = m_FixedSizes[column];
+    return fixedSize == 0 || record.payload.size() == fixedSize;
+  }
+
+  bool Index(const WpilogReader& reader, const WpilogExtractOptions& options) {
+    // Keys are matched by name and type so that an entry that is finished and started again stays one column
+    std::map<std::pair<std::string_view, std::string_view>, int32_t> columnsByKey;
+    std::vector<int32_t> mapping;
+    bool mappingChanged = true;
+
+    size_t offset = reader.GetRecordsOffset();
+    size_t recordOffset = offset;
+    WpilogRecord record;
+    Chunk* chunk = nullptr;
+
+    while (reader.ReadRecord(offset, record)) {
+      m_RecordCount++;
+
+      if (!chunk || recordOffset - chunk->begin >= options.chunkSize) {
+        if (chunk) {
+          chunk->end = recordOffset;
+        }
+        if (mappingChanged) {
+          m_Mappings.push_back(mapping);
+          mappingChanged = false;
+        }
+        chunk = &m_Chunks.emplace_back();
+        chunk->begin = recordOffset;
+        chunk->mapping = m_Mappings.size() - 1;
+      }
+
+      if (record.entry == 0) {
+        if (!IndexControl(record, recordOffset, options, columnsByKey, mapping)) {
+          return false;
+        }
+        mappingChanged = true;
+      } else if (record.entry < mapping.size() && mapping[record.entry] >= 0) {
+        auto column = static_cast<size_t>(mapping[record.entry]);
+        if (IsValidPayload(column, record)) {
+          if (chunk->rows.size() <= column) {
+            chunk->rows.resize(m_Columns.size());
+            chunk->bytes.resize(m_Columns.size());
+          }
+          chunk->rows[column]++;
+          chunk->bytes[column] += record.payload.size();
+        }
+      }
+
+      recordOffset = offset;
+    }
+
+    if (chunk) {
+      chunk->end = recordOffset;
+    }
+    return true;
+  }
+
+  bool IndexControl(const WpilogRecord& record, size_t recordOffset, const WpilogExtractOptions& options,
+                    std::map<std::pair<std::string_view, std::string_view>, int32_t>& columnsByKey,
+                    std::vector<int32_t>& mapping) {
+    WpilogStart start;
+    if (WpilogReader::ParseStart(record, start)) {
+      if (start.entry >= kMaxEntryId) {
+        m_Error = "Entry id " + std::to_string(start.entry) + " is too large";
+        return false;
+      }
+      if (start.entry >= mapping.size()) {
+        mapping.resize(start.entry + 1, -1);
+      }
+
+      int32_t column = -1;
+      if (options.Matches(start)) {
+        auto [it, added] = columnsByKey.try_emplace({start.name, start.type}, static_cast<int32_t>(m_Columns.size()));
+        if (added) {
+          WpilogColumn& newColumn = m_Columns.emplace_back();
+          newColumn.name = start.name;
+          newColumn.type = start.type;
+          newColumn.metadata = start.metadata;
+          m_FixedSizes.push_back(newColumn.GetFixedSize());
+        }
+        column = it->second;
+      }
+
+      mapping[start.entry] = column;
+      m_StartColumns[recordOffset] = column;
+      return true;
+    }
+
+    uint8_t control;
+    uint32_t entry;
+    if (!WpilogReader::ParseControlEntry(record, control, entry) || entry >= mapping.size()) {
+      return true;
+    }
+
+    std::string_view metadata;
+    if (control == WpilogReader::kControlFinish) {
+      mapping[entry] = -1;
+    } else if (WpilogReader::ParseSetMetadata(record, entry, metadata) && mapping[entry] >= 0) {
+      m_Columns[static_cast<size_t>(mapping[entry])].metadata = metadata;
+    }
+    return true;
+  }
+
+  // Size every column, and turn each chunk's counts into where its rows start
+  void Allocate() {
+    for (size_t column = 0; column < m_Columns.size(); column++) {
+      uint64_t rows = 0;
+      uint64_t bytes = 0;
+
+      for (Chunk& chunk : m_Chunks) {
+        if (chunk.rows.size() < m_Columns.size()) {
+          chunk.rows.resize(m_Columns.size());
+          chunk.bytes.resize(m_Columns.size());
+        }
+
+        uint64_t chunkRows = chunk.rows[column];
+        uint64_t chunkBytes = chunk.bytes[column];
+        chunk.rows[column] = rows;
+        chunk.bytes[column] = bytes;
+        rows += chunkRows;
+        bytes += chunkBytes;
+      }
+
+      WpilogColumn& result = m_Columns[column];
+      result.timestamps.resize(rows);
+      result.data.resize(bytes);
+      if (result.GetFixedSize() == 0) {
+        result.offsets.resize(rows + 1);
+        result.offsets[rows] = bytes;
+      }
+    }
+  }
+
+  void Decode(const WpilogReader& reader, const WpilogExtractOptions& options) {
+    unsigned threadCount = options.threadCount != 0 ? options.threadCount : std::thread::hardware_concurrency();
+    threadCount = std::clamp<unsigned>(threadCount, 1, static_cast<unsigned>(std::max<size_t>(m_Chunks.size(), 1)));
+
+    std::atomic<size_t> nextChunk{0};
+    auto work = [&] {
+      for (size_t i = nextChunk.fetch_add(1); i < m_Chunks.size(); i = nextChunk.fetch_add(1)) {
+        DecodeChunk(reader, m_Chunks[i]);
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; i++) {
+      threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+  // Only writes the rows Allocate() gave this chunk, so chunks can be decoded at the same time
+  void DecodeChunk(const WpilogReader& reader, Chunk& chunk) {
+    std::vector<int32_t> mapping = m_Mappings[chunk.mapping];
+
+    size_t offset = chunk.begin;
+    size_t recordOffset = offset;
+    WpilogRecord record;
+    while (offset < chunk.end && reader.ReadRecord(offset, record)) {
+      if (record.entry == 0) {
+        DecodeControl(record, recordOffset, mapping);
+      } else if (record.entry < mapping.size() && mapping[record.entry] >= 0) {
+        auto column = static_cast<size_t>(mapping[record.entry]);
+        WpilogColumn& result = m_Columns[column];
+
+        if (IsValidPayload(column, record)) {
+          uint64_t row = chunk.rows[column]++;
+          uint64_t byte = chunk.bytes[column];
+          chunk.bytes[column] += record.payload.size();
+
+          result.timestamps[row] = record.timestamp;
+          if (!result.offsets.empty()) {
+            result.offsets[row] = byte;
+          }
+          if (!record.payload.empty()) {
+            std::memcpy(result.data.data() + byte, record.payload.data(), record.payload.size());
+          }
+        }
+      }
+      recordOffset = offset;
+    }
+  }
+
+  void DecodeControl(const WpilogRecord& record, size_t recordOffset, std::vector<int32_t>& mapping) {
+    WpilogStart start;
+    if (WpilogReader::ParseStart(record, start)) {
+      if (start.entry >= mapping.size()) {
+        mapping.resize(start.entry + 1, -1);
+      }
+      mapping[start.entry] = m_StartColumns.at(recordOffset);
+      return;
+    }
+
+    uint8_t control;
+    uint32_t entry;
+    if (WpilogReader::ParseControlEntry(record, control, entry) && control == WpilogReader::kControlFinish &&
+        entry < mapping.size()) {
+      mapping[entry] = -1;
+    }
+  }
+
+  std::vector<WpilogColumn> m_Columns;
+  // Each column's GetFixedSize(), so records can be checked without comparing type strings
+  std::vector<size_t> m_FixedSizes;
+  std::vector<Chunk> m_Chunks;
+  // Snapshots of the entry id to column mapping, only taken when it changed since the last chunk
+  std::vector<std::vector<int32_t>> m_Mappings;
+  // Column for the start record at each offset, or -1 if the entry wasn't selected
+  std::unordered_map<size_t, int32_t> m_StartColumns;
+  uint64_t m_RecordCount = 0;
+  std::string m_Error;
+};
+
+/**
+ * Write the columns as CSV with one row per value: key,timestamp,value. Timestamps are in microseconds. Arrays are
+ * written as one quoted field with the elements separated by ';', and raw or struct payloads as hex.
+ */
+class WpilogCsvWriter {
+public:
+  static void Write(const std::vector<WpilogColumn>& columns, std::ostream& out) {
+    std::string buffer;
+    buffer.reserve(kFlushSize + 4096);
+    buffer += "key,timestamp,value\n";
+
+    for (const WpilogColumn& column : columns) {
+      std::string key;
+      AppendQuoted(key, column.name);
+      Format format = GetFormat(column.type);
+
+      for (size_t row = 0; row < column.GetRowCount(); row++) {
+        buffer += key;
+        buffer += ',';
+        AppendNumber(buffer, column.timestamps[row]);
+        buffer += ',';
+        AppendValue(buffer, format, column.GetPayload(row));
+        buffer += '\n';
+
+        if (buffer.size() >= kFlushSize) {
+          out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+          buffer.clear();
+        }
+      }
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  }
+
+private:
+  static constexpr size_t kFlushSize = size_t{1} << 20;
+
+  enum class Format {Boolean, Integer, Double, Float, String, BooleanArray, IntegerArray, DoubleArray, FloatArray,
+                     StringArray, Hex};
+
+  // Worked out once per column so that rows don't compare type strings
+  static Format GetFormat(std::string_view type) {
+    if (type == "boolean") {
+      return Format::Boolean;
+    }
+    if (type == "int64") {
+      return Format::Integer;
+    }
+    if (type == "double") {
+      return Format::Double;
+    }
+    if (type == "float") {
+      return Format::Float;
+    }
+    if (type == "string" || type == "json") {
+      return Format::String;
+    }
+    if (type == "boolean[]") {
+      return Format::BooleanArray;
+    }
+    if (type == "int64[]") {
+      return Format::IntegerArray;
+    }
+    if (type == "double[]") {
+      return Format::DoubleArray;
+    }
+    if (type == "float[]") {
+      return Format::FloatArray;
+    }
+    if (type == "string[]") {
+      return Format::StringArray;
+    }
+    return Format::Hex;
+  }
+
+  template<typename Number>
+  static void AppendNumber(std::string& buffer, Number value) {
+    char digits[32];
+    auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, end);
+  }
+
+  template<typename Element>
+  static Element ReadElement(const uint8_t* bytes) {
+    Element element;
+    std::memcpy(&element, bytes, sizeof(Element));
+    return element;
+  }
+
+  static void AppendQuoted(std::string& buffer, std::string_view text) {
+    buffer += '"';
+    for (char character : text) {
+      if (character == '"') {
+        buffer += '"';
+      }
+      buffer += character;
+    }
+    buffer += '"';
+  }
+
+  // Fixed size elements separated by ';'
+  template<typename Append>
+  static void AppendArray(std::string& buffer, std::span<const uint8_t> payload, size_t elementSize,
+                          Append&& append) {
+    buffer += '"';
+    for (size_t i = 0; i + elementSize <= payload.size(); i += elementSize) {
+      if (i != 0) {
+        buffer += ';';
+      }
+      append(payload.data() + i);
+    }
+    buffer += '"';
+  }
+
+  static void AppendValue(std::string& buffer, Format format, std::span<const uint8_t> payload) {
+    switch (format) {
+      case Format::Boolean:
+        buffer += payload[0] ? "true" : "false";
+        break;
+      case Format::Integer:
+        AppendNumber(buffer, ReadElement<int64_t>(payload.data()));
+        break;
+      case Format::Double:
+        AppendNumber(buffer, ReadElement<double>(payload.data()));
+        break;
+      case Format::Float:
+        AppendNumber(buffer, ReadElement<float>(payload.data()));
+        break;
+      case Format::String:
+        AppendQuoted(buffer, std::string_view(reinterpret_cast<const char*>(payload.data()), payload.size()));
+        break;
+      case Format::BooleanArray:
+        AppendArray(buffer, payload, 1, [&](const uint8_t* element) { buffer += *element ? "true" : "false"; });
+        break;
+      case Format::IntegerArray:
+        AppendArray(buffer, payload, 8, [&](const uint8_t* element) {
+          AppendNumber(buffer, ReadElement<int64_t>(element));
+        });
+        break;
+      case Format::DoubleArray:
+        AppendArray(buffer, payload, 8, [&](const uint8_t* element) {
+          AppendNumber(buffer, ReadElement<double>(element));
+        });
+        break;
+      case Format::FloatArray:
+        AppendArray(buffer, payload, 4, [&](const uint8_t* element) {
+          AppendNumber(buffer, ReadElement<float>(element));
+        });
+        break;
+      case Format::StringArray:
+        AppendStringArray(buffer, payload);
+        break;
+      case Format::Hex:
+        AppendHex(buffer, payload);
+        break;
+    }
+  }
+
+  // A 4 byte count, then each string as a 4 byte length and its bytes
+  static void AppendStringArray(std::string& buffer, std::span<const uint8_t> payload) {
+    std::string joined;
+    if (payload.size() >= 4) {
+      uint32_t count = WpilogReader::ReadInteger<uint32_t>(payload.data(), 4);
+      size_t position = 4;
+      for (uint32_t i = 0; i < count && payload.size() - position >= 4; i++) {
+        uint32_t length = WpilogReader::ReadInteger<uint32_t>(payload.data() + position, 4);
+        position += 4;
+        length = static_cast<uint32_t>(std::min<size_t>(length, payload.size() - position));
+
+        if (i != 0) {
+          joined += ';';
+        }
+        joined.append(reinterpret_cast<const char*>(payload.data() + position), length);
+        position += length;
+      }
+    }
+    AppendQuoted(buffer, joined);
+  }
+
+  static void AppendHex(std::string& buffer, std::span<const uint8_t> payload) {
+    static constexpr char kDigits[] = "0123456789abcdef";
+    for (uint8_t byte : payload) {
+      buffer += kDigits[byte >> 4];
+      buffer += kDigits[byte & 0xf];
+    }
+  }
+};
+
+/**
+ * Write the columns in a compact binary format that loads with a few reads per column, e.g. with numpy.fromfile.
+ * Everything is little endian:
+ *
+ *   "BLCOLS01"
+ *   uint32 column count
+ *   for each column:
+ *     uint32 name length, name
+ *     uint32 type length, type
+ *     uint64 row count
+ *     uint64 data length
+ *     uint8 1 if offsets follow, otherwise 0
+ *     int64 timestamps[row count]
+ *     uint64 offsets[row count + 1], only if present
+ *     data
+ */
+class WpilogColumnarWriter {
+public:
+  static constexpr std::string_view kMagic = "BLCOLS01";
+
+  static void Write(const std::vector<WpilogColumn>& columns, std::ostream& out) {
+    out.write(kMagic.data(), static_cast<std::streamsize>(kMagic.size()));
+    WriteInteger<uint32_t>(out, columns.size());
+
+    for (const WpilogColumn& column : columns) {
+      WriteString(out, column.name);
+      WriteString(out, column.type);
+      WriteInteger<uint64_t>(out, column.GetRowCount());
+      WriteInteger<uint64_t>(out, column.data.size());
+      WriteInteger<uint8_t>(out, column.offsets.empty() ? 0 : 1);
+
+      WriteArray(out, column.timestamps);
+      WriteArray(out, column.offsets);
+      WriteArray(out, column.data);
+    }
+  }
+
+private:
+  template<typename Integer>
+  static void WriteInteger(std::ostream& out, uint64_t value) {
+    auto integer = static_cast<Integer>(value);
+    out.write(reinterpret_cast<const char*>(&integer), sizeof(integer));
+  }
+
+  static void WriteString(std::ostream& out, const std::string& string) {
+    WriteInteger<uint32_t>(out, string.size());
+    out.write(string.data(), static_cast<std::streamsize>(string.size()));
+  }
+
+  template<typename Element>
+  static void WriteArray(std::ostream& out, const std::vector<Element>& array) {
+    out.write(reinterpret_cast<const char*>(array.data()),
+              static_cast<std::streamsize>(array.size() * sizeof(Element)));
+  }
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bearlog/internal/block_codec.h"
+
+/**
+ * A whole file mapped read-only into memory.
+ */
+class MappedFile {
+public:
+  MappedFile() = default;
+
+  ~MappedFile() {
+    Close();
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Open(const std::string& path) {
+    Close();
+
+#ifdef _WIN32
+    m_File = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!::GetFileSizeEx(m_File, &size)) {
+      Close();
+      return false;
+    }
+    m_Size = static_cast<size_t>(size.QuadPart);
+    if (m_Size == 0) {
+      return true;
+    }
+
+    m_Mapping = ::CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_Mapping) {
+      Close();
+      return false;
+    }
+    m_Data = static_cast<const uint8_t*>(::MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_Data) {
+      Close();
+      return false;
+    }
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+      return false;
+    }
+
+    struct stat info;
+    if (::fstat(file, &info) != 0) {
+      ::close(file);
+      return false;
+    }
+    m_Size = static_cast<size_t>(info.st_size);
+    if (m_Size == 0) {
+      ::close(file);
+      return true;
+    }
+
+    // The mapping keeps the file alive, so the descriptor isn't needed once it exists
+    void* data = ::mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED) {
+      m_Size = 0;
+      return false;
+    }
+    ::madvise(data, m_Size, MADV_SEQUENTIAL);
+    m_Data = static_cast<const uint8_t*>(data);
+#endif
+    return true;
+  }
+
+  void Close() {
+#ifdef _WIN32
+    if (m_Data) {
+      ::UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping) {
+      ::CloseHandle(m_Mapping);
+    }
+    if (m_File != INVALID_HANDLE_VALUE) {
+      ::CloseHandle(m_File);
+    }
+    m_Mapping = nullptr;
+    m_File = INVALID_HANDLE_VALUE;
+#else
+    if (m_Data) {
+      ::munmap(const_cast<uint8_t*>(m_Data), m_Size);
+    }
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+  }
+
+  std::span<const uint8_t> GetData() const {
+    return {m_Data, m_Size};
+  }
+
+private:
+  const uint8_t* m_Data = nullptr;
+  size_t m_Size = 0;
+#ifdef _WIN32
+  HANDLE m_File = INVALID_HANDLE_VALUE;
+  HANDLE m_Mapping = nullptr;
+#endif
+};
+
+/**
+ * One record from a .wpilog file. Entry 0 is the control entry, whose records start, finish and update the
+ * metadata of the other entries.
+ */
+struct WpilogRecord {
+  uint32_t entry = 0;
+  int64_t timestamp = 0;
+  std::span<const uint8_t> payload;
+};
+
+/**
+ * A control record that starts an entry. The strings point into the mapped file.
+ */
+struct WpilogStart {
+  uint32_t entry = 0;
+  std::string_view name;
+  std::string_view type;
+  std::string_view metadata;
+};
+
+/**
+ * Reads the .wpilog format written by wpi::log::DataLog, version 1.0, and segments compressed by SegmentedFileSink.
+ * Payloads are handed back as they are in the file, little endian.
+ */
+class WpilogReader {
+public:
+  static constexpr uint8_t kControlStart = 0;
+  static constexpr uint8_t kControlFinish = 1;
+  static constexpr uint8_t kControlSetMetadata = 2;
+
+  /**
+   * Map the file and check its header. Returns false, with the reason in GetError(), if the file can't be read or
+   * isn't a .wpilog file.
+   */
+  bool Open(const std::string& path) {
+    m_Data = {};
+    if (!m_File.Open(path)) {
+      m_Error = "Could not open " + path;
+      return false;
+    }
+
+    m_Data = m_File.GetData();
+    m_Decompressed.clear();
+    if (BlockCodec::IsCompressed(m_Data)) {
+      if (!BlockCodec::Decompress(m_Data, m_Decompressed)) {
+        m_Error = path + " is corrupt";
+        return false;
+      }
+      m_Data = m_Decompressed;
+    }
+
+    std::span<const uint8_t> data = m_Data;
+    // "WPILOG", a 2 byte version and a 4 byte extra header length
+    if (data.size() < 12 || std::memcmp(data.data(), "WPILOG", 6) != 0) {
+      m_Error = path + " is not a .wpilog file";
+      return false;
+    }
+
+    uint16_t version = ReadInteger<uint16_t>(data.data() + 6, 2);
+    if ((version >> 8) != 1) {
+      m_Error = path + " has unsupported .wpilog version " + std::to_string(version >> 8) + "." +
+                std::to_string(version & 0xff);
+      return false;
+    }
+
+    uint32_t extraHeaderLength = ReadInteger<uint32_t>(data.data() + 8, 4);
+    if (data.size() - 12 < extraHeaderLength) {
+      m_Error = path + " is truncated";
+      return false;
+    }
+    m_ExtraHeader = std::string_view(reinterpret_cast<const char*>(data.data() + 12), extraHeaderLength);
+    m_RecordsOffset = 12 + extraHeaderLength;
+    return true;
+  }
+
+  const std::string& GetError() const {
+    return m_Error;
+  }
+
+  std::span<const uint8_t> GetData() const {
+    return m_Data;
+  }
+
+  std::string_view GetExtraHeader() const {
+    return m_ExtraHeader;
+  }
+
+  // Offset of the first record
+  size_t GetRecordsOffset() const {
+    return m_RecordsOffset;
+  }
+
+  /**
+   * Read the record at offset and move offset past it. Returns false at the end of the data, or if the last record
+   * was cut off, which happens when the robot loses power while logging.
+   */
+  bool ReadRecord(size_t& offset, WpilogRecord& record) const {
+    std::span<const uint8_t> data = GetData();
+    if (offset >= data.size()) {
+      return false;
+    }
+
+    // One byte of field lengths: entry id in bits 0-1, payload size in bits 2-3, timestamp in bits 4-6
+    uint8_t lengths = data[offset];
+    size_t entryLength = (lengths & 0x3) + 1;
+    size_t sizeLength = ((lengths >> 2) & 0x3) + 1;
+    size_t timestampLength = ((lengths >> 4) & 0x7) + 1;
+
+    size_t headerLength = 1 + entryLength + sizeLength + timestampLength;
+    if (data.size() - offset < headerLength) {
+      return false;
+    }
+
+    const uint8_t* field = data.data() + offset + 1;
+    record.entry = ReadInteger<uint32_t>(field, entryLength);
+    field += entryLength;
+    uint32_t payloadSize = ReadInteger<uint32_t>(field, sizeLength);
+    field += sizeLength;
+    record.timestamp = ReadInteger<int64_t>(field, timestampLength);
+
+    if (data.size() - offset - headerLength < payloadSize) {
+      return false;
+    }
+    record.payload = data.subspan(offset + headerLength, payloadSize);
+    offset += headerLength + payloadSize;
+    return true;
+  }
+
+  /**
+   * Parse a control record that starts an entry. Returns false for any other kind of record.
+   */
+  static bool ParseStart(const WpilogRecord& record, WpilogStart& start) {
+    std::span<const uint8_t> payload = record.payload;
+    if (record.entry != 0 || payload.size() < 17 || payload[0] != kControlStart) {
+      return false;
+    }
+
+    size_t position = 1;
+    start.entry = ReadInteger<uint32_t>(payload.data() + position, 4);
+    position += 4;
+    return ReadString(payload, position, start.name) && ReadString(payload, position, start.type) &&
+           ReadString(payload, position, start.metadata);
+  }
+
+  /**
+   * The entry a finish or set metadata control record applies to.
+   */
+  static bool ParseControlEntry(const WpilogRecord& record, uint8_t& control, uint32_t& entry) {
+    if (record.entry != 0 || record.payload.size() < 5) {
+      return false;
+    }
+    control = record.payload[0];
+    entry = ReadInteger<uint32_t>(record.payload.data() + 1, 4);
+    return true;
+  }
+
+  static bool ParseSetMetadata(const WpilogRecord& record, uint32_t& entry, std::string_view& metadata) {
+    uint8_t control;
+    if (!ParseControlEntry(record, control, entry) || control != kControlSetMetadata) {
+      return false;
+    }
+    size_t position = 5;
+    return ReadString(record.payload, position, metadata);
+  }
+
+  // Little endian integer stored in length bytes. A byte loop, rather than a memcpy of a variable length, is
+  // inlined, which matters when reading millions of record headers.
+  template<typename Integer>
+  static Integer ReadInteger(const uint8_t* bytes, size_t length) {
+    uint64_t value = 0;
+    for (size_t i = length; i > 0; i--) {
+      value = (value << 8) | bytes[i - 1];
+    }
+    return static_cast<Integer>(value);
+  }
+
+private:
+  // A 4 byte length followed by that many bytes of UTF-8
+  static bool ReadString(std::span<const uint8_t> payload, size_t& position, std::string_view& string) {
+    if (payload.size() - position < 4) {
+      return false;
+    }
+    uint32_t length = ReadInteger<uint32_t>(payload.data() + position, 4);
+    position += 4;
+    if (payload.size() - position < length) {
+      return false;
+    }
+    string = std::string_view(reinterpret_cast<const char*>(payload.data() + position), length);
+    position += length;
+    return true;
+  }
+
+  MappedFile m_File;
+  // The whole log, either the mapped file or m_Decompressed
+  std::span<const uint8_t> m_Data;
+  std::vector<uint8_t> m_Decompressed;
+  std::string m_Error;
+  std::string_view m_ExtraHeader;
+  size_t m_RecordsOffset = 0;
+};
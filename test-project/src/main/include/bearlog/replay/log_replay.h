@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <frc/simulation/SimHooks.h>
+#include <units/time.h>
+#include <wpi/DataLogBackgroundWriter.h>
+#include <wpi/struct/Struct.h>
+
+#include "bearlog/bearlog.h"
+#include "bearlog/internal/unit_suffix.h"
+#include "bearlog/reader/wpilog_reader.h"
+
+/**
+ * Replays a .wpilog file written by BearLog into simulation, as fast as the CPU allows. Recorded values are read
+ * back as inputs with the same keys they were logged with, and sim time is stepped in lock step with the log, so
+ * whatever the robot code logs during the replay lands in the new log file at the same timestamps as the original:
+ *
+ *   LogReplay replay;
+ *   replay.StartOutputLog("replays", "match_12_replayed.wpilog");
+ *   replay.Open("FRC_20260321_183512.wpilog");
+ *   replay.Run([&] {
+ *     m_drive.SetGyroAngle(replay.GetUnits("Drive/GyroAngle", 0_deg));
+ *     m_drive.Periodic();
+ *   });
+ *
+ * Only for simulation, since it takes over sim timing. Every record is indexed when the log is opened and the
+ * payloads are read straight out of the memory-mapped file, so replaying doesn't copy the log.
+ */
+class LogReplay {
+public:
+  static constexpr units::second_t kDefaultPeriod{0.02};
+
+  /**
+   * Write everything BearLog logs during the replay to a new file, separate from DataLogManager's. Must be called
+   * before BearLog writes its first value to the log file. Returns false, and reports an error, if it was too late.
+   */
+  static bool StartOutputLog(std::string_view directory, std::string_view fileName) {
+    return BearLog::SetDataLog(std::make_unique<wpi::log::DataLogBackgroundWriter>(directory, fileName));
+  }
+
+  /**
+   * Map and index the log. Keys logged by BearLog, with or without the NT/ prefix, are replayed under the key they
+   * were logged with, like "Drive/GyroAngle(deg)". Every other entry keeps its full name. Returns false, with the
+   * reason in GetError(), if the file can't be read.
+   */
+  bool Open(const std::string& path) {
+    m_Values.clear();
+    m_ValuesByKey.clear();
+    m_Records.clear();
+    m_NextRecord = 0;
+
+    if (!m_Reader.Open(path)) {
+      m_Error = m_Reader.GetError();
+      return false;
+    }
+
+    Index();
+    return true;
+  }
+
+  const std::string& GetError() const {
+    return m_Error;
+  }
+
+  /**
+   * Apply every recorded value with a timestamp up to and including this one.
+   */
+  void AdvanceTo(int64_t timestamp) {
+    std::span<const uint8_t> data = m_Reader.GetData();
+
+    for (; m_NextRecord < m_Records.size() && m_Records[m_NextRecord].timestamp <= timestamp; m_NextRecord++) {
+      const IndexedRecord& record = m_Records[m_NextRecord];
+      ReplayValue& value = m_Values[record.value];
+      value.timestamp = record.timestamp;
+      value.payload = data.subspan(record.payloadOffset, record.payloadSize);
+    }
+  }
+
+  bool IsFinished() const {
+    return m_NextRecord == m_Records.size();
+  }
+
+  // Timestamp of the first recorded value, in microseconds
+  int64_t GetStartTimestamp() const {
+    return m_Records.empty() ? 0 : m_Records.front().timestamp;
+  }
+
+  /**
+   * Step through the whole log one period at a time. Each cycle first applies the values recorded up to the
+   * current time, then calls cycle(), then steps sim time by the period. Returns the number of cycles run.
+   */
+  uint64_t Run(const std::function<void()>& cycle, units::second_t period = kDefaultPeriod) {
+    auto periodMicros = static_cast<int64_t>(period.value() * 1e6);
+    int64_t timestamp = GetStartTimestamp();
+
+    // Line sim time up with the log, so values logged during the replay get the original timestamps
+    frc::sim::PauseTiming();
+    frc::sim::RestartTiming();
+    frc::sim::StepTiming(units::second_t{static_cast<double>(timestamp) / 1e6});
+
+    uint64_t cycles = 0;
+    while (!IsFinished()) {
+      AdvanceTo(timestamp);
+      cycle();
+      frc::sim::StepTiming(period);
+      timestamp += periodMicros;
+      cycles++;
+    }
+    return cycles;
+  }
+
+  /**
+   * True once a value has been replayed for the key.
+   */
+  bool Has(std::string_view key) const {
+    const ReplayValue* value = Find(key);
+    return value && value->timestamp >= 0;
+  }
+
+  // Timestamp of the key's current value, or nothing if it doesn't have one yet
+  std::optional<int64_t> GetTimestamp(std::string_view key) const {
+    const ReplayValue* value = Find(key);
+    if (!value || value->timestamp < 0) {
+      return std::nullopt;
+    }
+    return value->timestamp;
+  }
+
+  /**
+   * The current value of a key, or defaultValue if it hasn't been replayed yet or was logged with another type.
+   */
+  bool GetBoolean(std::string_view key, bool defaultValue) const {
+    std::span<const uint8_t> payload = GetPayload(key, "boolean", 1);
+    return payload.empty() ? defaultValue : payload[0] != 0;
+  }
+
+  double GetDouble(std::string_view key, double defaultValue) const {
+    return GetScalar<double>(key, "double", defaultValue);
+  }
+
+  int64_t GetInteger(std::string_view key, int64_t defaultValue) const {
+    return GetScalar<int64_t>(key, "int64", defaultValue);
+  }
+
+  std::string_view GetString(std::string_view key, std::string_view defaultValue) const {
+    const ReplayValue* value = FindCurrent(key, "string");
+    if (!value) {
+      return defaultValue;
+    }
+    return std::string_view(reinterpret_cast<const char*>(value->payload.data()), value->payload.size());
+  }
+
+  /**
+   * Units values were logged as doubles with the unit in the key, so this looks up "key(unit)".
+   */
+  template<UnitType Units>
+  Units GetUnits(std::string_view key, Units defaultValue) const {
+    std::string keyWithUnits(key);
+    keyWithUnits += UnitSuffix<Units>::kValue;
+    return Units{GetDouble(keyWithUnits, defaultValue.value())};
+  }
+
+  template<wpi::StructSerializable S>
+  std::optional<S> GetStruct(std::string_view key) const {
+    std::string typeString = "struct:" + std::string(wpi::Struct<S>::GetTypeName());
+    std::span<const uint8_t> payload = GetPayload(key, typeString, wpi::GetStructSize<S>());
+    if (payload.empty()) {
+      return std::nullopt;
+    }
+    return wpi::UnpackStruct<S>(payload);
+  }
+
+  /**
+   * Copy a numeric or boolean array into values. Returns false, leaving values alone, if the key hasn't been
+   * replayed yet or was logged with another type.
+   */
+  bool GetArray(std::string_view key, std::vector<double>& values) const {
+    return GetArray(key, "double[]", values);
+  }
+
+  bool GetArray(std::string_view key, std::vector<float>& values) const {
+    return GetArray(key, "float[]", values);
+  }
+
+  bool GetArray(std::string_view key, std::vector<int64_t>& values) const {
+    return GetArray(key, "int64[]", values);
+  }
+
+  bool GetArray(std::string_view key, std::vector<bool>& values) const {
+    const ReplayValue* value = FindCurrent(key, "boolean[]");
+    if (!value) {
+      return false;
+    }
+    values.assign(value->payload.begin(), value->payload.end());
+    return true;
+  }
+
+private:
+  // The latest replayed value of one key. The payload points into the mapped file.
+  struct ReplayValue {
+    std::string key;
+    std::string type;
+    int64_t timestamp = -1;
+    std::span<const uint8_t> payload;
+  };
+
+  struct IndexedRecord {
+    int64_t timestamp;
+    uint32_t value;
+    uint32_t payloadSize;
+    uint64_t payloadOffset;
+  };
+
+  // The key BearLog logged an entry under, from the name DataLogWriter::GetPrefixKey() gave it
+  static std::string_view GetReplayKey(const WpilogStart& start) {
+    static constexpr std::string_view kSource = "\"source\":\"BearLog\"";
+    static constexpr std::string_view kPrefixes[] = {"NT//Robot/", "/Robot/"};
+
+    if (start.metadata.find(kSource) != std::string_view::npos) {
+      for (std::string_view prefix : kPrefixes) {
+        if (start.name.starts_with(prefix)) {
+          return start.name.substr(prefix.size());
+        }
+      }
+    }
+    return start.name;
+  }
+
+  // Walk the file once, resolving every record to its key while entry ids still mean what the file says they do,
+  // then sort by time. BearLog writes some values late, like flight recorder dumps, so file order isn't time order.
+  void Index() {
+    std::vector<int32_t> entries;
+    size_t offset = m_Reader.GetRecordsOffset();
+    WpilogRecord record;
+    bool sorted = true;
+
+    while (m_Reader.ReadRecord(offset, record)) {
+      if (record.entry == 0) {
+        IndexControl(record, entries);
+        continue;
+      }
+      if (record.entry >= entries.size() || entries[record.entry] < 0) {
+        continue;
+      }
+
+      auto payloadOffset = static_cast<uint64_t>(record.payload.data() - m_Reader.GetData().data());
+      sorted = sorted && (m_Records.empty() || m_Records.back().timestamp <= record.timestamp);
+      m_Records.push_back(IndexedRecord{record.timestamp, static_cast<uint32_t>(entries[record.entry]),
+                                        static_cast<uint32_t>(record.payload.size()), payloadOffset});
+    }
+
+    // Stable, so values with the same timestamp replay in the order they were logged
+    if (!sorted) {
+      std::stable_sort(m_Records.begin(), m_Records.end(),
+                       [](const IndexedRecord& a, const IndexedRecord& b) { return a.timestamp < b.timestamp; });
+    }
+  }
+
+  void IndexControl(const WpilogRecord& record, std::vector<int32_t>& entries) {
+    WpilogStart start;
+    if (WpilogReader::ParseStart(record, start)) {
+      // DataLog hands out entry ids in order, so a huge one means the record is corrupt
+      if (start.entry >= (1u << 24)) {
+        return;
+      }
+      if (start.entry >= entries.size()) {
+        entries.resize(start.entry + 1, -1);
+      }
+
+      std::string_view key = GetReplayKey(start);
+      auto it = m_ValuesByKey.find(key);
+      if (it == m_ValuesByKey.end()) {
+        it = m_ValuesByKey.emplace(std::string(key), m_Values.size()).first;
+        m_Values.push_back(ReplayValue{std::string(key), std::string(start.type), -1, {}});
+      }
+      entries[start.entry] = static_cast<int32_t>(it->second);
+      return;
+    }
+
+    uint8_t control;
+    uint32_t entry;
+    if (WpilogReader::ParseControlEntry(record, control, entry) && control == WpilogReader::kControlFinish &&
+        entry < entries.size()) {
+      entries[entry] = -1;
+    }
+  }
+
+  const ReplayValue* Find(std::string_view key) const {
+    auto it = m_ValuesByKey.find(key);
+    return it != m_ValuesByKey.end() ? &m_Values[it->second] : nullptr;
+  }
+
+  // The key's value, if it has one and it was logged as this type
+  const ReplayValue* FindCurrent(std::string_view key, std::string_view type) const {
+    const ReplayValue* value = Find(key);
+    if (!value || value->timestamp < 0 || value->type != type) {
+      return nullptr;
+    }
+    return value;
+  }
+
+  // Empty unless the key has a value of this type and size
+  std::span<const uint8_t> GetPayload(std::string_view key, std::string_view type, size_t size) const {
+    const ReplayValue* value = FindCurrent(key, type);
+    if (!value || value->payload.size() != size) {
+      return {};
+    }
+    return value->payload;
+  }
+
+  template<typename Scalar>
+  Scalar GetScalar(std::string_view key, std::string_view type, Scalar defaultValue) const {
+    std::span<const uint8_t> payload = GetPayload(key, type, sizeof(Scalar));
+    if (payload.empty()) {
+      return defaultValue;
+    }
+
+    // The payload isn't aligned, so copy it out rather than casting the pointer
+    Scalar value;
+    std::memcpy(&value, payload.data(), sizeof(Scalar));
+    return value;
+  }
+
+  template<typename Element>
+  bool GetArray(std::string_view key, std::string_view type, std::vector<Element>& values) const {
+    const ReplayValue* value = FindCurrent(key, type);
+    if (!value) {
+      return false;
+    }
+
+    values.resize(value->payload.size() / sizeof(Element));
+    std::memcpy(values.data(), value->payload.data(), values.size() * sizeof(Element));
+    return true;
+  }
+
+  WpilogReader m_Reader;
+  std::string m_Error;
+
+  std::vector<ReplayValue> m_Values;
+  // std::less<> lets keys be looked up by string_view without building a string
+  std::map<std::string, size_t, std::less<>> m_ValuesByKey;
+  std::vector<IndexedRecord> m_Records;
+  size_t m_NextRecord = 0;
+};
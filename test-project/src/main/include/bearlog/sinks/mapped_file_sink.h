@@ -0,0 +1,388 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "bearlog/internal/log_sink.h"
+
+/**
+ * A .wpilog file being written through a memory mapping. The file is preallocated and mapped in extents that double
+ * as it grows, so writing a record is a copy into memory and the OS writes the pages back in the background. Not
+ * thread safe; the sinks that use it hold a lock around it.
+ */
+class MappedWpilogFile {
+public:
+  // Small enough that a short log doesn't hold much of the roboRIO's flash. The file doubles from there, by at most
+  // kMaxExtent at a time.
+  static constexpr size_t kDefaultExtent = 2 * 1024 * 1024;
+  static constexpr size_t kMaxExtent = 64 * 1024 * 1024;
+  static constexpr std::string_view kEntryMetadata = "{\"source\":\"BearLog\"}";
+
+  MappedWpilogFile() = default;
+
+  ~MappedWpilogFile() {
+    Close();
+  }
+
+  MappedWpilogFile(const MappedWpilogFile&) = delete;
+  MappedWpilogFile& operator=(const MappedWpilogFile&) = delete;
+
+  /**
+   * Create the file, replacing any file already there, and write the .wpilog header. extent is how much space the
+   * file starts with. Returns false, with the reason in GetError(), if the file can't be created.
+   */
+  bool Open(const std::string& path, size_t extent = kDefaultExtent) {
+    Close();
+    m_Extent = extent;
+
+#ifdef _WIN32
+    m_Error = "Memory-mapped log files are not supported on Windows";
+    return false;
+#else
+    m_File = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_File < 0) {
+      m_Error = "Could not create " + path;
+      return false;
+    }
+
+    // "WPILOG", version 1.0 and an empty extra header
+    static constexpr uint8_t kHeader[] = {'W', 'P', 'I', 'L', 'O', 'G', 0x00, 0x01, 0, 0, 0, 0};
+    if (!Reserve(sizeof(kHeader))) {
+      Close();
+      return false;
+    }
+    std::memcpy(m_Data, kHeader, sizeof(kHeader));
+    m_Size = sizeof(kHeader);
+    return true;
+#endif
+  }
+
+  /**
+   * Unmap the file and cut it down to what was written.
+   */
+  void Close() {
+#ifndef _WIN32
+    if (m_Data) {
+      ::munmap(m_Data, m_Capacity);
+    }
+    if (m_File >= 0) {
+      // Drop the unused end of the last extent
+      if (::ftruncate(m_File, static_cast<off_t>(m_Size)) != 0) {
+        m_Error = "Could not trim the log file";
+      }
+      ::close(m_File);
+    }
+    m_File = -1;
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Capacity = 0;
+  }
+
+  bool IsOpen() const {
+    return m_Data != nullptr;
+  }
+
+  const std::string& GetError() const {
+    return m_Error;
+  }
+
+  // Bytes written so far, including the header
+  size_t GetSize() const {
+    return m_Size;
+  }
+
+  /**
+   * Write a control record that starts an entry.
+   */
+  bool WriteStart(int entry, std::string_view name, std::string_view type, std::string_view metadata,
+                  uint64_t timestamp) {
+    // Reused for every control record
+    m_Control.clear();
+    m_Control.push_back(0);
+    AppendInteger(m_Control, static_cast<uint32_t>(entry));
+    for (std::string_view string : {name, type, metadata}) {
+      AppendInteger(m_Control, static_cast<uint32_t>(string.size()));
+      m_Control.insert(m_Control.end(), string.begin(), string.end());
+    }
+    return WriteRecord(0, m_Control, timestamp);
+  }
+
+  /**
+   * Write one record. Returns false if the file isn't open or couldn't grow to fit it, usually because the disk is
+   * full.
+   */
+  bool WriteRecord(uint32_t entry, std::span<const uint8_t> payload, uint64_t timestamp) {
+    if (!m_Data) {
+      return false;
+    }
+
+    size_t entryLength = ByteLength(entry);
+    size_t sizeLength = ByteLength(payload.size());
+    size_t timestampLength = ByteLength(timestamp);
+    size_t recordSize = 1 + entryLength + sizeLength + timestampLength + payload.size();
+
+    if (!Reserve(m_Size + recordSize)) {
+      return false;
+    }
+
+    uint8_t* out = m_Data + m_Size;
+    // Field lengths: entry id in bits 0-1, payload size in bits 2-3, timestamp in bits 4-6
+    *out++ = static_cast<uint8_t>((entryLength - 1) | ((sizeLength - 1) << 2) | ((timestampLength - 1) << 4));
+    out = WriteInteger(out, entry, entryLength);
+    out = WriteInteger(out, payload.size(), sizeLength);
+    out = WriteInteger(out, timestamp, timestampLength);
+    if (!payload.empty()) {
+      std::memcpy(out, payload.data(), payload.size());
+    }
+    m_Size += recordSize;
+    return true;
+  }
+
+  /**
+   * Start writing what has been written so far back to the file, without waiting for it.
+   */
+  void Flush() {
+#ifndef _WIN32
+    if (m_Data) {
+      ::msync(m_Data, m_Size, MS_ASYNC);
+    }
+#endif
+  }
+
+private:
+  // Fewest bytes that hold the value, which is how DataLog keeps record headers small
+  static size_t ByteLength(uint64_t value) {
+    size_t length = 1;
+    while (length < 8 && (value >> (length * 8)) != 0) {
+      length++;
+    }
+    return length;
+  }
+
+  static uint8_t* WriteInteger(uint8_t* out, uint64_t value, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      out[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+    return out + length;
+  }
+
+  static void AppendInteger(std::vector<uint8_t>& buffer, uint32_t value) {
+    size_t offset = buffer.size();
+    buffer.resize(offset + 4);
+    WriteInteger(buffer.data() + offset, value, 4);
+  }
+
+  // Grow the file, and the mapping, until size bytes fit. Each step doubles the file, between the first extent and
+  // kMaxExtent, so a long log only remaps a handful of times.
+  bool Reserve(size_t size) {
+    if (size <= m_Capacity) {
+      return true;
+    }
+
+#ifdef _WIN32
+    return false;
+#else
+    size_t capacity = m_Capacity;
+    while (capacity < size) {
+      capacity += std::clamp(capacity, m_Extent, std::max(m_Extent, kMaxExtent));
+    }
+
+#ifdef __linux__
+    // Allocate the blocks now so a full disk shows up here, rather than as SIGBUS when a page is first written
+    if (::posix_fallocate(m_File, static_cast<off_t>(m_Capacity), static_cast<off_t>(capacity - m_Capacity)) != 0) {
+      m_Error = "Could not grow the log file";
+      return false;
+    }
+    void* data = m_Data ? ::mremap(m_Data, m_Capacity, capacity, MREMAP_MAYMOVE)
+                        : ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+#else
+    if (::ftruncate(m_File, static_cast<off_t>(capacity)) != 0) {
+      m_Error = "Could not grow the log file";
+      return false;
+    }
+    if (m_Data) {
+      ::munmap(m_Data, m_Capacity);
+      m_Data = nullptr;
+    }
+    void* data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+#endif
+
+    if (data == MAP_FAILED) {
+      m_Error = "Could not map the log file";
+      return false;
+    }
+    m_Data = static_cast<uint8_t*>(data);
+    m_Capacity = capacity;
+    return true;
+#endif
+  }
+
+  std::string m_Error;
+  size_t m_Extent = kDefaultExtent;
+  uint8_t* m_Data = nullptr;
+  size_t m_Size = 0;
+  size_t m_Capacity = 0;
+#ifndef _WIN32
+  int m_File = -1;
+#endif
+  std::vector<uint8_t> m_Control;
+};
+
+/**
+ * Writes .wpilog records straight into a memory-mapped file, skipping DataLog's buffers and writer thread.
+ * Appending a value is a copy into memory and the OS writes the pages back in the background. Pair it with
+ * BearLogOptions::FileOutput::SinksOnly to make it the only copy of the log:
+ *
+ *   auto sink = std::make_shared<MappedFileSink>();
+ *   if (sink->Open("/u/logs/bearlog.wpilog")) {
+ *     BearLog::AddSink(sink);
+ *   }
+ *
+ * Entries are named with the table prefix BearLog uses in DataLogManager's log, like "NT//Robot/Drive/Speed", and
+ * tagged as BearLog's, so LogReplay and the extractor read them like any other BearLog log. Only supported on Linux
+ * and macOS, including the roboRIO.
+ */
+class MappedFileSink : public BearLogSink {
+public:
+  static constexpr size_t kDefaultExtent = MappedWpilogFile::kDefaultExtent;
+
+  /**
+   * extent is how much space the file starts with. It doubles each time it fills up, so the file only remaps a few
+   * times during a match.
+   */
+  explicit MappedFileSink(size_t extent = kDefaultExtent) : m_Extent(extent) {}
+
+  /**
+   * Create the file, replacing any file already there, and write the .wpilog header. Returns false, with the reason
+   * in GetError(), if the file can't be created.
+   *
+   * BearLog keeps the entry IDs a sink hands out, so reopening starts every entry again in the new file under the
+   * same ID.
+   */
+  bool Open(const std::string& path) {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_DroppedRecords = 0;
+    if (!m_File.Open(path, m_Extent)) {
+      return false;
+    }
+
+    for (size_t i = 0; i < m_Entries.size(); i++) {
+      const StartedEntry& started = m_Entries[i];
+      int entry = static_cast<int>(i + 1);
+      m_File.WriteStart(entry, started.name, started.type, started.metadata, started.timestamp);
+      if (!started.schema.empty()) {
+        Write(entry, std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(started.schema.data()),
+                                              started.schema.size()), started.timestamp);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Unmap the file and cut it down to what was written. Values appended after this are ignored.
+   */
+  void Close() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_File.Close();
+  }
+
+  const std::string& GetError() const {
+    return m_File.GetError();
+  }
+
+  // Bytes written so far, including the header
+  size_t GetSize() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_File.GetSize();
+  }
+
+  // Values thrown away because the file couldn't grow, usually because the disk is full
+  uint64_t GetDroppedRecordCount() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_DroppedRecords;
+  }
+
+  int StartEntry(std::string_view key, std::string_view typeString, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return AddEntry(key, typeString, MappedWpilogFile::kEntryMetadata, "", timestamp);
+  }
+
+  void Append(int entry, std::span<const uint8_t> payload, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    Write(entry, payload, timestamp);
+  }
+
+  void AppendBatch(std::span<const SinkRecord> records) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    for (const SinkRecord& record : records) {
+      Write(record.entry, record.payload, record.timestamp);
+    }
+  }
+
+  // Written the way DataLog writes them, as an entry per type that holds the schema as its one value
+  void AddSchema(std::string_view typeString, std::string_view schema, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_Schemas.emplace(typeString).second) {
+      return;
+    }
+
+    int entry = AddEntry(".schema/" + std::string(typeString), "structschema", "", schema, timestamp);
+    Write(entry, std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(schema.data()), schema.size()),
+          timestamp);
+  }
+
+  void Flush() override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_File.Flush();
+  }
+
+private:
+  // Kept to start the entry again when the sink is reopened. schema is only set for schema entries.
+  struct StartedEntry {
+    std::string name;
+    std::string type;
+    std::string metadata;
+    std::string schema;
+    uint64_t timestamp;
+  };
+
+  int AddEntry(std::string_view name, std::string_view type, std::string_view metadata, std::string_view schema,
+               uint64_t timestamp) {
+    m_Entries.push_back(StartedEntry{std::string(name), std::string(type), std::string(metadata),
+                                     std::string(schema), timestamp});
+    int entry = static_cast<int>(m_Entries.size());
+    m_File.WriteStart(entry, name, type, metadata, timestamp);
+    return entry;
+  }
+
+  // Appends after Close() aren't counted as dropped
+  void Write(int entry, std::span<const uint8_t> payload, uint64_t timestamp) {
+    if (!m_File.WriteRecord(static_cast<uint32_t>(entry), payload, timestamp) && m_File.IsOpen()) {
+      m_DroppedRecords++;
+    }
+  }
+
+  const size_t m_Extent;
+
+  std::mutex m_Mutex;
+  MappedWpilogFile m_File;
+  uint64_t m_DroppedRecords = 0;
+  // Indexed by entry id - 1
+  std::vector<StartedEntry> m_Entries;
+  // Struct types whose schema entry exists. std::less<> lets them be found by string_view.
+  std::set<std::string, std::less<>> m_Schemas;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bearlog/internal/log_sink.h"
+
+/**
+ * Keeps everything written to it in memory, for checking what BearLog logged from a test or a simulation run.
+ * Payloads are in the .wpilog encoding, so a double is its 8 bytes and a string is its characters.
+ */
+class MemorySink : public BearLogSink {
+public:
+  struct Entry {
+    std::string key;
+    std::string type;
+  };
+
+  struct Value {
+    int entry;
+    uint64_t timestamp;
+    std::vector<uint8_t> payload;
+  };
+
+  int StartEntry(std::string_view key, std::string_view typeString, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Entries.push_back(Entry{std::string(key), std::string(typeString)});
+    // Entry IDs are indexes into GetEntries(), plus one since .wpilog entry IDs start at 1
+    return static_cast<int>(m_Entries.size());
+  }
+
+  void Append(int entry, std::span<const uint8_t> payload, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Values.push_back(Value{entry, timestamp, std::vector<uint8_t>(payload.begin(), payload.end())});
+  }
+
+  void AppendBatch(std::span<const SinkRecord> records) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    for (const SinkRecord& record : records) {
+      m_Values.push_back(
+          Value{record.entry, record.timestamp, std::vector<uint8_t>(record.payload.begin(), record.payload.end())});
+    }
+  }
+
+  std::vector<Entry> GetEntries() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Entries;
+  }
+
+  std::vector<Value> GetValues() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Values;
+  }
+
+  /**
+   * Every value written for a key, oldest first. The key includes the table prefix, like "NT//Robot/Drive/Speed".
+   */
+  std::vector<Value> GetValues(std::string_view key) {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    std::vector<Value> values;
+    for (const Value& value : m_Values) {
+      if (m_Entries[value.entry - 1].key == key) {
+        values.push_back(value);
+      }
+    }
+    return values;
+  }
+
+  // Forget the values written so far. Entries are kept, since BearLog won't start them again.
+  void Clear() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Values.clear();
+  }
+
+private:
+  std::mutex m_Mutex;
+  std::vector<Entry> m_Entries;
+  std::vector<Value> m_Values;
+};
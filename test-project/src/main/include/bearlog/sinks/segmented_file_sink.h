@@ -0,0 +1,491 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include <units/time.h>
+
+#include "bearlog/internal/block_codec.h"
+#include "bearlog/internal/log_sink.h"
+#include "bearlog/sinks/mapped_file_sink.h"
+
+/**
+ * Writes the log as a series of .wpilog segments, starting a new file once a segment reaches a size or covers a
+ * length of time. Each segment begins by starting every entry again and writing its latest value, so any segment
+ * can be opened on its own. Closed segments are compressed with BlockCodec on a low priority background thread,
+ * and the oldest ones are deleted to keep the directory under a disk budget:
+ *
+ *   auto sink = std::make_shared<SegmentedFileSink>("/u/logs");
+ *   sink->SetMaxSegmentDuration(60_s).SetDiskBudget(512 * 1024 * 1024);
+ *   if (sink->Open()) {
+ *     BearLog::SetOptions(BearLogOptions().SetFileOutput(BearLogOptions::FileOutput::SinksOnly));
+ *     BearLog::AddSink(sink);
+ *   }
+ *
+ * Segments are named name_00001.wpilog, name_00002.wpilog and so on, with ".blz" added once compressed.
+ * WpilogReader, LogReplay and bearlogExtract read compressed segments as they are. Only supported on Linux and
+ * macOS, including the roboRIO.
+ */
+class SegmentedFileSink : public BearLogSink {
+public:
+  enum class Compression {None, BlockCodec};
+
+  static constexpr size_t kDefaultMaxSegmentSize = 16 * 1024 * 1024;
+  static constexpr units::second_t kDefaultMaxSegmentDuration{300};
+  static constexpr uint64_t kDefaultDiskBudget = 256 * 1024 * 1024;
+
+  static constexpr std::string_view kSegmentExtension = ".wpilog";
+  static constexpr std::string_view kCompressedExtension = ".blz";
+
+  explicit SegmentedFileSink(std::string directory, std::string name = "bearlog")
+      : m_Directory(std::move(directory)), m_Name(std::move(name)) {}
+
+  ~SegmentedFileSink() override {
+    Close();
+  }
+
+  SegmentedFileSink(const SegmentedFileSink&) = delete;
+  SegmentedFileSink& operator=(const SegmentedFileSink&) = delete;
+
+  /**
+   * Start a new segment once the current one would grow past this many bytes. Only takes effect if set before
+   * Open().
+   */
+  SegmentedFileSink& SetMaxSegmentSize(size_t bytes) {
+    m_MaxSegmentSize = std::max<size_t>(bytes, 64 * 1024);
+    return *this;
+  }
+
+  /**
+   * Start a new segment once the current one covers this much log time. 0 only starts new segments by size. Only
+   * takes effect if set before Open().
+   */
+  SegmentedFileSink& SetMaxSegmentDuration(units::second_t duration) {
+    m_MaxSegmentDuration = duration;
+    return *this;
+  }
+
+  /**
+   * Delete the oldest segments once every segment in the directory adds up to more than this many bytes. The
+   * segment being written counts for what has been written to it so far, and it is never deleted, nor are
+   * segments still waiting to be compressed. 0 keeps every segment. Only takes effect if set before Open().
+   */
+  SegmentedFileSink& SetDiskBudget(uint64_t bytes) {
+    m_DiskBudget = bytes;
+    return *this;
+  }
+
+  // Applies from the next segment that is closed
+  SegmentedFileSink& SetCompression(Compression compression) {
+    m_Compression.store(compression, std::memory_order_relaxed);
+    return *this;
+  }
+
+  /**
+   * Create the directory if needed and start the first segment, numbered after any segments already there.
+   * Returns false, with the reason in GetError(), if the segment can't be created.
+   */
+  bool Open() {
+    Close();
+
+    std::error_code error;
+    std::filesystem::create_directories(m_Directory, error);
+
+    uint64_t next = 1;
+    for (const Segment& segment : ListSegments()) {
+      next = std::max(next, segment.index + 1);
+    }
+
+    {
+      const std::lock_guard<std::mutex> lock(m_Mutex);
+      m_NextSegment = next;
+      m_DroppedRecords = 0;
+      if (!StartSegment(0)) {
+        return false;
+      }
+    }
+
+    m_Stop = false;
+    m_Worker = std::thread(&SegmentedFileSink::RunWorker, this);
+    return true;
+  }
+
+  /**
+   * Close the current segment and wait for the background thread to finish compressing it. Values appended after
+   * this are ignored.
+   */
+  void Close() {
+    {
+      const std::lock_guard<std::mutex> lock(m_Mutex);
+      CloseSegment();
+      m_RetryingSegment = false;
+    }
+
+    if (m_Worker.joinable()) {
+      {
+        const std::lock_guard<std::mutex> lock(m_WorkMutex);
+        m_Stop = true;
+      }
+      m_WorkAvailable.notify_one();
+      m_Worker.join();
+    }
+  }
+
+  std::string GetError() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Error;
+  }
+
+  // The segment being written, or empty once closed
+  std::string GetCurrentPath() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_File.IsOpen() ? GetSegmentPath(m_CurrentSegment) : std::string();
+  }
+
+  // Values thrown away because a segment couldn't grow or a new one couldn't be created
+  uint64_t GetDroppedRecordCount() {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_DroppedRecords;
+  }
+
+  int StartEntry(std::string_view key, std::string_view typeString, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    return AddEntry(key, typeString, MappedWpilogFile::kEntryMetadata, timestamp);
+  }
+
+  void Append(int entry, std::span<const uint8_t> payload, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    Write(entry, payload, timestamp);
+  }
+
+  void AppendBatch(std::span<const SinkRecord> records) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    for (const SinkRecord& record : records) {
+      Write(record.entry, record.payload, record.timestamp);
+    }
+  }
+
+  // Kept as an entry like any other, so every segment gets the schemas again along with the latest values
+  void AddSchema(std::string_view typeString, std::string_view schema, uint64_t timestamp) override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_Schemas.emplace(typeString).second) {
+      return;
+    }
+
+    int entry = AddEntry(".schema/" + std::string(typeString), "structschema", "", timestamp);
+    Write(entry, std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(schema.data()), schema.size()),
+          timestamp);
+  }
+
+  void Flush() override {
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_File.Flush();
+  }
+
+private:
+  // Microseconds of log time between attempts to start a segment after one couldn't be created
+  static constexpr uint64_t kSegmentRetryPeriod = 1000000;
+
+  // An entry as it needs to be started again at the top of each segment
+  struct EntryState {
+    std::string name;
+    std::string type;
+    std::string metadata;
+    std::vector<uint8_t> lastPayload;
+    uint64_t lastTimestamp = 0;
+    bool hasValue = false;
+  };
+
+  struct Segment {
+    uint64_t index;
+    std::filesystem::path path;
+    uint64_t size;
+  };
+
+  int AddEntry(std::string_view name, std::string_view type, std::string_view metadata, uint64_t timestamp) {
+    EntryState& state = m_Entries.emplace_back();
+    state.name = name;
+    state.type = type;
+    state.metadata = metadata;
+    int entry = static_cast<int>(m_Entries.size());
+    m_File.WriteStart(entry, name, type, metadata, timestamp);
+    return entry;
+  }
+
+  void Write(int entry, std::span<const uint8_t> payload, uint64_t timestamp) {
+    if (m_RetryingSegment) {
+      if (timestamp < m_LastSegmentRetry + kSegmentRetryPeriod) {
+        m_DroppedRecords++;
+        return;
+      }
+      // The background thread may have freed space since the last try
+      m_LastSegmentRetry = timestamp;
+      if (!StartSegment(timestamp)) {
+        m_DroppedRecords++;
+        return;
+      }
+      m_RetryingSegment = false;
+    } else if (!m_File.IsOpen()) {
+      return;
+    }
+
+    if (IsSegmentFull(payload.size(), timestamp) && !StartSegment(timestamp)) {
+      // Keep trying, every value until a segment opens is dropped
+      m_RetryingSegment = true;
+      m_LastSegmentRetry = timestamp;
+      m_DroppedRecords++;
+      return;
+    }
+    if (m_SegmentStart == 0) {
+      m_SegmentStart = timestamp;
+    }
+
+    if (!m_File.WriteRecord(static_cast<uint32_t>(entry), payload, timestamp)) {
+      m_DroppedRecords++;
+      return;
+    }
+    m_SegmentValues++;
+
+    // Kept to start the entry again at the top of the next segment
+    EntryState& state = m_Entries[entry - 1];
+    state.lastPayload.assign(payload.begin(), payload.end());
+    state.lastTimestamp = timestamp;
+    state.hasValue = true;
+  }
+
+  bool IsSegmentFull(size_t payloadSize, uint64_t timestamp) const {
+    // A segment always takes at least one value after its header, or a header bigger than the limit would start
+    // a new segment for every value
+    if (m_SegmentValues == 0) {
+      return false;
+    }
+
+    // The largest record header is 17 bytes
+    if (m_File.GetSize() + payloadSize + 17 > m_MaxSegmentSize) {
+      return true;
+    }
+
+    auto maxMicros = static_cast<uint64_t>(m_MaxSegmentDuration.value() * 1e6);
+    return maxMicros > 0 && timestamp >= m_SegmentStart + maxMicros;
+  }
+
+  /**
+   * Close the current segment and start the next one with every entry started again and its latest value.
+   */
+  bool StartSegment(uint64_t timestamp) {
+    CloseSegment();
+
+    // A retry reuses the number, so segments stay consecutive
+    std::string path = GetSegmentPath(m_NextSegment);
+    if (!m_File.Open(path, std::min(m_MaxSegmentSize, MappedWpilogFile::kDefaultExtent))) {
+      m_Error = m_File.GetError();
+      return false;
+    }
+    m_CurrentSegment = m_NextSegment++;
+    m_SegmentStart = timestamp;
+    m_SegmentValues = 0;
+
+    for (size_t i = 0; i < m_Entries.size(); i++) {
+      const EntryState& state = m_Entries[i];
+      m_File.WriteStart(static_cast<int>(i + 1), state.name, state.type, state.metadata, timestamp);
+    }
+    // Values keep their original timestamps, which can be older than the segment
+    for (size_t i = 0; i < m_Entries.size(); i++) {
+      const EntryState& state = m_Entries[i];
+      if (state.hasValue) {
+        m_File.WriteRecord(static_cast<uint32_t>(i + 1), state.lastPayload, state.lastTimestamp);
+      }
+    }
+    return true;
+  }
+
+  // Hand the current segment, if there is one, to the background thread
+  void CloseSegment() {
+    if (!m_File.IsOpen()) {
+      return;
+    }
+    m_File.Close();
+
+    {
+      const std::lock_guard<std::mutex> lock(m_WorkMutex);
+      m_ClosedSegments.push_back(GetSegmentPath(m_CurrentSegment));
+    }
+    m_WorkAvailable.notify_one();
+  }
+
+  std::string GetSegmentPath(uint64_t index) const {
+    char number[21];
+    std::snprintf(number, sizeof(number), "%05llu", static_cast<unsigned long long>(index));
+    return (std::filesystem::path(m_Directory) / (m_Name + "_" + number + std::string(kSegmentExtension))).string();
+  }
+
+  // Every finished or compressed segment in the directory, oldest first
+  std::vector<Segment> ListSegments() const {
+    std::vector<Segment> segments;
+    std::string prefix = m_Name + "_";
+    std::error_code error;
+
+    for (const auto& file : std::filesystem::directory_iterator(m_Directory, error)) {
+      std::string fileName = file.path().filename().string();
+      std::string_view stem = fileName;
+      if (stem.ends_with(kCompressedExtension)) {
+        stem.remove_suffix(kCompressedExtension.size());
+      }
+      if (!stem.starts_with(prefix) || !stem.ends_with(kSegmentExtension)) {
+        continue;
+      }
+
+      std::string_view number = stem.substr(prefix.size(), stem.size() - prefix.size() - kSegmentExtension.size());
+      if (number.empty() || !std::all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        continue;
+      }
+
+      std::error_code sizeError;
+      uint64_t size = file.file_size(sizeError);
+      segments.push_back(Segment{std::stoull(std::string(number)), file.path(), sizeError ? 0 : size});
+    }
+
+    std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.index < b.index; });
+    return segments;
+  }
+
+  void RunWorker() {
+#ifdef __linux__
+    // Linux applies nice values to single threads, so this only lowers this thread's priority
+    ::setpriority(PRIO_PROCESS, 0, 19);
+#endif
+
+    BlockCodec codec;
+    while (true) {
+      std::string path;
+      {
+        std::unique_lock<std::mutex> lock(m_WorkMutex);
+        m_WorkAvailable.wait(lock, [this] { return m_Stop || !m_ClosedSegments.empty(); });
+        if (m_ClosedSegments.empty()) {
+          return;
+        }
+        path = std::move(m_ClosedSegments.front());
+        m_ClosedSegments.pop_front();
+      }
+
+      if (m_Compression.load(std::memory_order_relaxed) == Compression::BlockCodec) {
+        CompressSegment(codec, path);
+      }
+      EnforceDiskBudget();
+    }
+  }
+
+  // Written under a temporary name first, so a crash never leaves a half written segment that looks finished. The
+  // uncompressed segment is kept if compressing fails.
+  static void CompressSegment(BlockCodec& codec, const std::string& path) {
+    std::string compressedPath = path + std::string(kCompressedExtension);
+    std::string temporaryPath = compressedPath + ".tmp";
+    std::error_code error;
+
+    if (!codec.CompressFile(path, temporaryPath)) {
+      std::filesystem::remove(temporaryPath, error);
+      return;
+    }
+    std::filesystem::rename(temporaryPath, compressedPath, error);
+    if (error) {
+      std::filesystem::remove(temporaryPath, error);
+      return;
+    }
+    std::filesystem::remove(path, error);
+  }
+
+  void EnforceDiskBudget() {
+    if (m_DiskBudget == 0) {
+      return;
+    }
+
+    // The current segment's file is preallocated past what has been written, which the budget shouldn't count
+    uint64_t current;
+    uint64_t currentSize;
+    {
+      const std::lock_guard<std::mutex> lock(m_Mutex);
+      current = m_File.IsOpen() ? m_CurrentSegment : 0;
+      currentSize = m_File.GetSize();
+    }
+    std::set<std::filesystem::path> pending;
+    {
+      const std::lock_guard<std::mutex> lock(m_WorkMutex);
+      for (const std::string& path : m_ClosedSegments) {
+        pending.insert(std::filesystem::path(path).filename());
+      }
+    }
+
+    std::vector<Segment> segments = ListSegments();
+    uint64_t total = 0;
+    for (Segment& segment : segments) {
+      if (segment.index == current) {
+        segment.size = currentSize;
+      }
+      total += segment.size;
+    }
+
+    for (const Segment& segment : segments) {
+      if (total <= m_DiskBudget) {
+        break;
+      }
+      if (segment.index == current || pending.contains(segment.path.filename())) {
+        continue;
+      }
+
+      std::error_code error;
+      if (std::filesystem::remove(segment.path, error)) {
+        total -= segment.size;
+      }
+    }
+  }
+
+  const std::string m_Directory;
+  const std::string m_Name;
+  size_t m_MaxSegmentSize = kDefaultMaxSegmentSize;
+  units::second_t m_MaxSegmentDuration = kDefaultMaxSegmentDuration;
+  uint64_t m_DiskBudget = kDefaultDiskBudget;
+  // Read by the background thread
+  std::atomic<Compression> m_Compression{Compression::BlockCodec};
+
+  // Protects everything about the segment being written, and m_Error
+  std::mutex m_Mutex;
+  std::string m_Error;
+  MappedWpilogFile m_File;
+  uint64_t m_CurrentSegment = 0;
+  uint64_t m_NextSegment = 1;
+  // Log time of the first value in the segment
+  uint64_t m_SegmentStart = 0;
+  uint64_t m_SegmentValues = 0;
+  uint64_t m_DroppedRecords = 0;
+  // Set when starting a new segment failed, so Write() tries again at most once per kSegmentRetryPeriod
+  bool m_RetryingSegment = false;
+  uint64_t m_LastSegmentRetry = 0;
+  // Indexed by entry id - 1
+  std::vector<EntryState> m_Entries;
+  // Struct types whose schema entry exists. std::less<> lets them be found by string_view.
+  std::set<std::string, std::less<>> m_Schemas;
+
+  // Protects the hand off of closed segments to the background thread
+  std::mutex m_WorkMutex;
+  std::condition_variable m_WorkAvailable;
+  std::deque<std::string> m_ClosedSegments;
+  bool m_Stop = false;
+  std::thread m_Worker;
+};
@@ -0,0 +1,198 @@
+// Hammers BearLog from several threads at once, to shake out races under a sanitizer.
+//
+//   bearlogStress [--producers <count>] [--keys <count>] [--duration <s>] [--options-period <ms>]
+//                 [--sink-period <ms>]
+//
+// Producers register keys through every kind of Log() call while other threads swap the options and sinks. It
+// checks nothing itself: build it with -Ptsan and ThreadSanitizer reports any race.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <frc/DataLogManager.h>
+#include <frc/geometry/Pose2d.h>
+#include <hal/HAL.h>
+#include <networktables/NetworkTableInstance.h>
+
+#include "bearlog/bearlog.h"
+#include "bearlog/sinks/memory_sink.h"
+
+namespace {
+
+struct StressOptions {
+  size_t producers = 4;
+  // New keys each producer registers before it starts over with the keys it already has
+  size_t keys = 2000;
+  double duration = 10;
+  int optionsPeriodMillis = 5;
+  int sinkPeriodMillis = 2;
+};
+
+// Logs through every overload, so each of them registers keys while the options and sinks change underneath it
+void Produce(size_t id, const StressOptions& options, const std::atomic<bool>& running, std::atomic<uint64_t>& calls) {
+  std::string prefix = "Stress/Producer" + std::to_string(id) + "/";
+  BearLog::Entry<double> entry{prefix + "Entry"};
+  BearLog::Logger logger = BearLog::Sub(prefix + "Logger");
+  std::vector<double> array(8);
+
+  for (uint64_t i = 0; running.load(std::memory_order_relaxed); i++) {
+    std::string key = prefix + std::to_string(i % options.keys);
+    double value = static_cast<double>(i);
+
+    switch (i % 6) {
+      case 0:
+        BearLog::Log(key, value);
+        break;
+      case 1:
+        BearLog::Log(key + "/Integer", static_cast<int>(i));
+        break;
+      case 2:
+        BearLog::Log(key + "/String", i % 2 == 0 ? "Even" : "Odd");
+        break;
+      case 3:
+        array.assign(array.size(), value);
+        BearLog::Log(key + "/Array", std::span<const double>(array));
+        break;
+      case 4:
+        BearLog::Log(key + "/Pose", frc::Pose2d{units::meter_t{value}, units::meter_t{0}, units::radian_t{0}});
+        break;
+      case 5:
+        BearLog::Log(key + "/Lazy", [value] { return value * 2; });
+        break;
+    }
+    entry.Log(value);
+    logger.Log("Value", value);
+    calls.fetch_add(3, std::memory_order_relaxed);
+  }
+}
+
+// Flips between every combination that changes which threads and writers are running
+void SwapOptions(const StressOptions& options, const std::atomic<bool>& running, std::atomic<uint64_t>& swaps) {
+  for (uint64_t i = 0; running.load(std::memory_order_relaxed); i++) {
+    BearLogOptions bearLogOptions(i % 2 == 0 ? BearLogOptions::NTPublish::Yes : BearLogOptions::NTPublish::No,
+                                  i % 4 < 2 ? BearLogOptions::LogWithNTPrefix::Yes
+                                            : BearLogOptions::LogWithNTPrefix::No,
+                                  i % 3 != 0 ? BearLogOptions::LogExtras::Yes : BearLogOptions::LogExtras::No,
+                                  i % 5 < 2 ? BearLogOptions::AsyncLogging::Yes : BearLogOptions::AsyncLogging::No);
+    bearLogOptions.SetExtrasRate(BearLogOptions::Extras::BearLog, units::hertz_t{500});
+    bearLogOptions.AddRateLimit(BearLogOptions::Sink::NetworkTables, "Stress/", units::hertz_t{10});
+    BearLog::SetOptions(std::move(bearLogOptions));
+    swaps.fetch_add(1, std::memory_order_relaxed);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.optionsPeriodMillis));
+  }
+}
+
+void SwapSinks(const StressOptions& options, const std::atomic<bool>& running, std::atomic<uint64_t>& swaps) {
+  std::shared_ptr<MemorySink> sink;
+  while (running.load(std::memory_order_relaxed)) {
+    if (sink) {
+      BearLog::RemoveSink(sink);
+      sink.reset();
+    } else {
+      sink = std::make_shared<MemorySink>();
+      BearLog::AddSink(sink);
+    }
+    swaps.fetch_add(1, std::memory_order_relaxed);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.sinkPeriodMillis));
+  }
+  if (sink) {
+    BearLog::RemoveSink(sink);
+  }
+}
+
+int PrintUsage() {
+  std::fprintf(stderr,
+               "Usage: bearlogStress [options]\n"
+               "\n"
+               "  --producers       Threads logging new keys. Defaults to 4.\n"
+               "  --keys            Keys each producer registers before reusing them. Defaults to 2000.\n"
+               "  --duration        Seconds to run for. Defaults to 10.\n"
+               "  --options-period  Milliseconds between calls to SetOptions(). Defaults to 5.\n"
+               "  --sink-period     Milliseconds between adding or removing a sink. Defaults to 2.\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  StressOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view argument = argv[i];
+    if (i + 1 >= argc) {
+      return PrintUsage();
+    }
+    std::string_view value = argv[++i];
+    bool valid = true;
+
+    if (argument == "--producers") {
+      options.producers = std::strtoul(value.data(), nullptr, 10);
+    } else if (argument == "--keys") {
+      options.keys = std::strtoul(value.data(), nullptr, 10);
+      valid = options.keys > 0;
+    } else if (argument == "--duration") {
+      options.duration = std::strtod(value.data(), nullptr);
+    } else if (argument == "--options-period") {
+      options.optionsPeriodMillis = std::atoi(value.data());
+    } else if (argument == "--sink-period") {
+      options.sinkPeriodMillis = std::atoi(value.data());
+    } else {
+      valid = false;
+    }
+
+    if (!valid) {
+      return PrintUsage();
+    }
+  }
+
+  // The simulated HAL, for the FPGA clock BearLog timestamps values with
+  if (!HAL_Initialize(500, 0)) {
+    std::fprintf(stderr, "Could not initialize the HAL\n");
+    return 1;
+  }
+  frc::DataLogManager::Start();
+  nt::NetworkTableInstance::GetDefault().StartServer();
+
+  std::atomic<bool> running{true};
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> optionSwaps{0};
+  std::atomic<uint64_t> sinkSwaps{0};
+
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < options.producers; p++) {
+    threads.emplace_back(Produce, p, std::cref(options), std::cref(running), std::ref(calls));
+  }
+  threads.emplace_back(SwapOptions, std::cref(options), std::cref(running), std::ref(optionSwaps));
+  threads.emplace_back(SwapSinks, std::cref(options), std::cref(running), std::ref(sinkSwaps));
+
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                     std::chrono::duration<double>(options.duration));
+  for (uint64_t iteration = 0; std::chrono::steady_clock::now() < end; iteration++) {
+    {
+      BearLog::Cycle cycle;
+      BearLog::Log("Stress/Main/Iteration", static_cast<int>(iteration));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  running.store(false);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  BearLog::SetOptions(BearLogOptions());
+
+  std::printf("%llu calls, %llu option swaps, %llu sink swaps, %llu dropped async records\n",
+              static_cast<unsigned long long>(calls.load()), static_cast<unsigned long long>(optionSwaps.load()),
+              static_cast<unsigned long long>(sinkSwaps.load()),
+              static_cast<unsigned long long>(BearLog::GetDroppedRecordCount()));
+  return 0;
+}